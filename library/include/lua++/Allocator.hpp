@@ -0,0 +1,228 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <unordered_set>
+
+/**
+ * @file lua++/Allocator.hpp
+ * @brief Memory allocators for %Lua states
+*/
+
+namespace Lua {
+	/**
+	 * @brief Base class for allocators owned by State.
+	 *
+	 * Pass allocator to State constructor to make State use it for all %Lua memory.
+	 * Allocator is destroyed together with State, after `lua_close`, so it never
+	 * has to be shared between States and needs no locking.
+	*/
+	class Allocator {
+		public:
+			virtual ~Allocator() = default; ///< Virtual destructor.
+
+			/**
+			 * @brief Allocate, resize or free block (same contract as `lua_Alloc`).
+			 *
+			 * @param ptr Block to be resized or freed (`nullptr` for new block).
+			 * @param osize Size of block (if `ptr` isn't `nullptr`).
+			 * @param nsize New size (zero to free block).
+			 * @return New block or `nullptr` on failure (or when freeing).
+			*/
+			virtual void* reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept = 0;
+
+			/// `lua_Alloc` forwarding to allocator passed as `ud`.
+			static void* luaAlloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize) noexcept {
+				return static_cast<Allocator*>(ud)->reallocate(ptr, osize, nsize);
+				};
+		};
+
+	/// Memory usage counters (see State::memoryStats()).
+	struct MemoryStats {
+		std::size_t current = 0;     ///< Bytes currently allocated.
+		std::size_t peak = 0;        ///< Highest value of `current` (see AccountingAllocator::resetPeak()).
+		std::size_t allocations = 0; ///< Number of blocks allocated.
+		std::size_t frees = 0;       ///< Number of blocks freed.
+		std::size_t limit = 0;       ///< Byte budget (zero if unlimited).
+		};
+
+	/**
+	 * @brief Allocator which counts memory and enforces byte budget.
+	 *
+	 * Wraps another allocator (or `std::realloc` by default). Requests which would
+	 * take State over the limit are refused, which makes %Lua raise memory error;
+	 * State turns it into Lua::MemoryLimitError, so it can be told apart from real
+	 * out-of-memory condition.
+	 *
+	 * ```
+	 * Lua::State L(Lua::DefaultLibsPreset::SAFE, std::make_unique<Lua::AccountingAllocator>(16 * 1024 * 1024));
+	 * …
+	 * std::cout << L.memoryStats().peak << std::endl;
+	 * ```
+	 *
+	 * @note %Lua runs emergency collection and retries before reporting failure,
+	 * so limit is only hit when memory is really in use.
+	*/
+	class AccountingAllocator: public Allocator {
+		private:
+			std::unique_ptr<Allocator> inner; ///< Allocator doing actual work (may be empty).
+			MemoryStats stats;                ///< Counters.
+			bool limitHit = false;            ///< Was last failure caused by limit.
+		public:
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param limit Byte budget (zero for unlimited).
+			 * @param inner Allocator to be wrapped (`std::realloc` if empty).
+			*/
+			explicit AccountingAllocator(std::size_t limit = 0, std::unique_ptr<Allocator> inner = nullptr);
+
+			void* reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept override;
+
+			/// Get counters.
+			[[nodiscard]] const MemoryStats& getStats() const noexcept { return stats; };
+			/// Change byte budget (zero for unlimited). Memory already in use is not affected.
+			void setLimit(std::size_t limit) noexcept { stats.limit = limit; };
+			/// Set peak to current usage.
+			void resetPeak() noexcept { stats.peak = stats.current; };
+			/// Check whether last failure was caused by limit and clear the flag.
+			bool consumeLimitHit() noexcept { bool res = limitHit; limitHit = false; return res; };
+		};
+
+	/**
+	 * @brief Allocator with per-size-class freelists for small blocks.
+	 *
+	 * Most of %Lua allocations are small objects of few fixed sizes (strings,
+	 * tables, closures, upvalues). Blocks up to maxSmallSize bytes are carved out of
+	 * slabs, one list of slabs per size class, and recycled through freelists.
+	 * Bigger blocks go to `std::realloc`.
+	 *
+	 * Slab is returned to system as soon as it becomes empty (one empty slab per
+	 * class is kept to avoid thrashing on alloc/free cycles).
+	 *
+	 * Shrinking never fails, as %Lua requires: if block can't be moved to smaller
+	 * class, it's kept where it is. Size class is taken from slab, not from size
+	 * passed by %Lua, and big blocks which couldn't move into slab are recognized
+	 * by looking up their address in list of slabs.
+	 *
+	 * ```
+	 * Lua::State L(Lua::DefaultLibsPreset::SAFE, std::make_unique<Lua::PoolAllocator>());
+	 * ```
+	 *
+	 * @note Not thread-safe, which is fine for allocator owned by single State.
+	*/
+	class PoolAllocator: public Allocator {
+		public:
+			static constexpr std::size_t slabSize = 64 * 1024;  ///< Size (and alignment) of slab.
+			static constexpr std::size_t maxSmallSize = 512;    ///< Biggest block served from slabs.
+			static constexpr std::size_t granularity = 16;      ///< Size classes step (also block alignment).
+
+			PoolAllocator() = default; ///< Default constructor.
+			PoolAllocator(const PoolAllocator&) = delete; ///< Explicitly deleted to prevent copy.
+			PoolAllocator& operator=(const PoolAllocator&) = delete; ///< Explicitly deleted to prevent copy.
+			~PoolAllocator() override; ///< Free all slabs.
+
+			void* reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept override;
+
+			/// Number of slabs currently allocated.
+			[[nodiscard]] std::size_t getSlabCount() const noexcept { return slabCount; };
+		private:
+			struct Slab;
+
+			/// Slabs of single size class.
+			struct SizeClass {
+				Slab* partial = nullptr; ///< Slabs with free blocks.
+				Slab* empty = nullptr;   ///< Cached empty slab.
+				};
+
+			static constexpr std::size_t classCount = maxSmallSize / granularity;
+
+			std::array<SizeClass, classCount> classes {}; ///< Size classes, by `(size - 1) / granularity`.
+			std::size_t slabCount = 0;                    ///< Number of allocated slabs.
+			std::unordered_set<const Slab*> slabs;        ///< All allocated slabs.
+			std::size_t misfiled = 0;                     ///< Big blocks %Lua thinks are small (after failed shrink).
+
+			static constexpr std::size_t slabHeaderSize() noexcept; ///< Size of Slab rounded up to granularity.
+			static Slab* slabOf(void* ptr) noexcept;                ///< Slab block would belong to if it's small.
+			bool isSmall(void* ptr, std::size_t osize) const noexcept;     ///< Does block live in slab.
+			void* allocSmall(std::size_t cls) noexcept;             ///< Allocate block of given class.
+			void freeSmall(void* ptr) noexcept;                     ///< Free block (class is taken from its slab).
+			void releaseSlab(Slab* slab) noexcept;                  ///< Return slab to system.
+		};
+
+	/**
+	 * @brief Bump allocator for short-lived States.
+	 *
+	 * Blocks are carved out of big chunks one after another, freeing small block is
+	 * a no-op (unless it's the last one allocated). Blocks bigger than `chunkSize / 8`
+	 * are allocated separately and freed as usual. All memory is released at once
+	 * when allocator is destroyed, so `lua_close` has nothing to free.
+	 *
+	 * Memory of freed small blocks is not reused, so it's only good for States
+	 * which live for one request or task. There are two ways to use it:
+	 *
+	 * ```
+	 * // Owned by State: everything is released with State
+	 * Lua::State L(Lua::DefaultLibsPreset::SAFE, std::make_unique<Lua::ArenaAllocator>());
+	 *
+	 * // Reused: chunks are kept for next State after reset()
+	 * Lua::ArenaAllocator arena;
+	 * for (auto& request : requests) {
+	 *     {
+	 *     Lua::State L(Lua::DefaultLibsPreset::SAFE, Lua::Allocator::luaAlloc, &arena);
+	 *     …
+	 *     }
+	 *     arena.reset();
+	 *     }
+	 * ```
+	 *
+	 * @note Finalizers (`__gc`) are still run by `lua_close`, only memory handling is skipped.
+	 * @note If large block can't be moved when shrunk, it's kept as is and released only by reset().
+	*/
+	class ArenaAllocator: public Allocator {
+		public:
+			static constexpr std::size_t alignment = 16; ///< Alignment of all blocks.
+
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param chunkSize Size of single chunk (bytes).
+			*/
+			explicit ArenaAllocator(std::size_t chunkSize = 256 * 1024);
+			ArenaAllocator(const ArenaAllocator&) = delete; ///< Explicitly deleted to prevent copy.
+			ArenaAllocator& operator=(const ArenaAllocator&) = delete; ///< Explicitly deleted to prevent copy.
+			~ArenaAllocator() override; ///< Free everything.
+
+			void* reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept override;
+
+			/**
+			 * @brief Forget all blocks, making arena ready for next State.
+			 *
+			 * Big blocks are freed, chunks are kept for reuse unless `keepChunks` is false.
+			 *
+			 * @warning State using arena must be destroyed first.
+			*/
+			void reset(bool keepChunks = true) noexcept;
+
+			/// Number of chunks allocated (including ones kept by reset()).
+			[[nodiscard]] std::size_t getChunkCount() const noexcept { return chunkCount; };
+		private:
+			struct Chunk;
+			struct Large;
+
+			std::size_t chunkSize;         ///< Size of chunk.
+			std::size_t largeThreshold;    ///< Blocks bigger than this are allocated separately.
+			Chunk* chunks = nullptr;       ///< Chunks in use, current one first.
+			Chunk* spare = nullptr;        ///< Chunks kept by reset().
+			Large* large = nullptr;        ///< Separately allocated blocks.
+			char* cur = nullptr;           ///< Free space in current chunk.
+			char* end = nullptr;           ///< End of current chunk.
+			std::size_t chunkCount = 0;    ///< Number of chunks.
+
+			void* allocate(std::size_t size) noexcept;      ///< Allocate new block.
+			void* allocLarge(std::size_t size) noexcept;    ///< Allocate separate block.
+			void freeLarge(void* ptr) noexcept;             ///< Free separate block.
+			bool nextChunk() noexcept;                      ///< Switch to fresh chunk.
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @file lua++/BytecodeCache.hpp
+ * @brief Content-addressed cache of compiled %Lua chunks
+*/
+
+namespace Lua {
+	/**
+	 * @brief Cache of compiled chunks keyed by hash of source and chunk name.
+	 *
+	 * When attached to State (see State::setBytecodeCache()), `State::load` for strings and
+	 * `State::loadFile` first look up compiled chunk here and load it in binary mode,
+	 * skipping parser completely. On miss, source is compiled as usual and result of
+	 * `lua_dump` is stored.
+	 *
+	 * Cache has two levels:
+	 * 1. In-memory LRU limited by total size of stored bytecode.
+	 * 2. Optional on-disk directory, one file per chunk. Files are written to temporary
+	 * name and renamed, so directory may be shared between processes.
+	 *
+	 * Object is thread-safe and can be shared between States (use `std::shared_ptr`).
+	 *
+	 * @warning %Lua doesn't verify binary chunks. Make sure cache directory is
+	 * writable only by trusted users. Chunks from other %Lua builds are rejected by
+	 * %Lua and transparently recompiled.
+	 * @note Key covers %Lua version and sizes of `lua_Integer`/`lua_Number`, and stripped
+	 * chunks are stored in separate files, so differently configured processes can share
+	 * directory. Chunk is only used if source length and second, independent hash stored
+	 * with it match too. Hashes aren't cryptographic, though.
+	*/
+	class BytecodeCache {
+		public:
+			/// Cache key (hashes of source and chunk name).
+			struct Key {
+				std::uint64_t hash = 0;   ///< Primary hash (FNV-1a), used for lookups and file names.
+				std::uint64_t check = 0;  ///< Independent hash (MurmurHash64A), verified before use.
+				std::uint64_t length = 0; ///< Length of source.
+
+				bool operator==(const Key& other) const noexcept { return hash == other.hash and check == other.check and length == other.length; };
+				bool operator!=(const Key& other) const noexcept { return !(*this == other); };
+				};
+			using Chunk = std::shared_ptr<const std::string>; ///< Stored bytecode.
+
+			/// Cache usage counters.
+			struct Stats {
+				std::size_t hits = 0;        ///< Lookups served from memory.
+				std::size_t diskHits = 0;    ///< Lookups served from disk.
+				std::size_t misses = 0;      ///< Failed lookups.
+				std::size_t entries = 0;     ///< Chunks in memory.
+				std::size_t memoryBytes = 0; ///< Total size of chunks in memory.
+				};
+
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param maxMemory Maximum total size of bytecode kept in memory (bytes).
+			 * @param directory Directory for on-disk cache (created if missing). Empty to disable.
+			 * @param strip Strip debug information from stored chunks (smaller, but error
+			 * messages lose line numbers).
+			*/
+			explicit BytecodeCache(std::size_t maxMemory = 16 * 1024 * 1024, std::filesystem::path directory = {}, bool strip = false);
+			BytecodeCache(const BytecodeCache&) = delete; ///< Explicitly deleted to prevent copy.
+			BytecodeCache& operator=(const BytecodeCache&) = delete; ///< Explicitly deleted to prevent copy.
+
+			/// Compute key for given source and chunk name (for %Lua build library was compiled with).
+			static Key hash(std::string_view source, std::string_view name) noexcept;
+
+			/**
+			 * @brief Find compiled chunk.
+			 * @return Bytecode or `nullptr` on miss.
+			*/
+			Chunk find(const Key& key);
+			/// Store compiled chunk (both in memory and on disk, if enabled).
+			void store(const Key& key, std::string bytecode);
+			/// Remove chunk (e.g. if %Lua rejected it).
+			void erase(const Key& key);
+			/// Drop in-memory entries (disk is left intact).
+			void clear();
+
+			/// Should stored chunks be stripped.
+			[[nodiscard]] bool getStrip() const noexcept { return strip; };
+			/// Get usage counters.
+			[[nodiscard]] Stats getStats() const;
+		private:
+			using LruList = std::list<std::pair<Key, Chunk>>;
+
+			/// Hasher for index.
+			struct KeyHash {
+				std::size_t operator()(const Key& key) const noexcept { return static_cast<std::size_t>(key.hash); };
+				};
+
+			std::size_t maxMemory;            ///< Memory limit.
+			std::filesystem::path directory;  ///< Disk cache location (empty if disabled).
+			bool strip;                       ///< Strip debug info.
+			std::uint64_t tmpSalt;            ///< Random value to make temporary file names unique.
+
+			mutable std::mutex mutex;                         ///< Protects fields below.
+			LruList lru;                                      ///< Entries, most recently used first.
+			std::unordered_map<Key, LruList::iterator, KeyHash> index; ///< Key to LRU position.
+			Stats stats;                                      ///< Counters (`entries` is computed on request).
+			std::uint64_t tmpCounter = 0;                     ///< Counter for temporary file names.
+
+			std::filesystem::path pathFor(const Key& key) const; ///< File name for key.
+			std::string fileHeader(const Key& key) const;        ///< Header written before bytecode in file.
+			void insert(const Key& key, Chunk chunk);            ///< Insert into LRU (lock must be held).
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
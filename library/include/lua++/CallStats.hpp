@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+/**
+ * @file lua++/CallStats.hpp
+ * @brief Call statistics of C++ bindings
+*/
+
+namespace Lua {
+	/**
+	 * @brief Call counters and latency histograms of C++ bindings, by name.
+	 *
+	 * Filled by calls of CppFunction and CppFunctionWrapper (including TypeHelper
+	 * methods) once enabled with State::enableCallStats(). Every State has its own
+	 * statistics and only touches them from its own thread, so no locking is done.
+	 *
+	 * Binding is named after the way it was called (global, field or method name,
+	 * as in %Lua tracebacks); TypeHelper methods are named `Type:method`.
+	 *
+	 * ```
+	 * L.enableCallStats();
+	 * …
+	 * L.getCallStats()->writeReport(std::cerr);
+	 * ```
+	*/
+	class CallStats {
+		public:
+			/// Number of histogram buckets. Bucket `i` counts calls taking [2^(i-1), 2^i) ns (last one also counts longer ones).
+			static constexpr std::size_t bucketCount = 32;
+
+			/// Statistics of single binding.
+			struct Binding {
+				std::uint64_t calls = 0;                           ///< Number of calls.
+				std::chrono::nanoseconds total {};                 ///< Total time spent.
+				std::chrono::nanoseconds max {};                   ///< Longest call.
+				std::array<std::uint64_t, bucketCount> histogram {}; ///< Calls by log2 of duration in ns.
+
+				/// Mean duration of call.
+				[[nodiscard]] std::chrono::nanoseconds mean() const noexcept { return calls ? total / static_cast<std::int64_t>(calls) : std::chrono::nanoseconds(0); };
+				/**
+				 * @brief Estimate percentile from histogram.
+				 *
+				 * @param p Percentile (from 0 to 1).
+				 * @return Upper bound of bucket containing it.
+				*/
+				[[nodiscard]] std::chrono::nanoseconds percentile(double p) const noexcept;
+				};
+
+			/// Add call to statistics.
+			void record(const std::string& name, std::chrono::nanoseconds duration) { record(getBinding(name), duration); };
+			/// Add call to statistics of binding got from getBinding().
+			static void record(Binding& binding, std::chrono::nanoseconds duration) noexcept;
+			/**
+			 * @brief Get (or create) statistics of binding.
+			 *
+			 * Reference stays valid until reset() (see getGeneration()).
+			*/
+			Binding& getBinding(const std::string& name) { return bindings[name]; };
+			/// Forget everything.
+			void reset() noexcept { bindings.clear(); ++generation; };
+			/// Number of reset() calls, used to check if cached Binding references are still valid.
+			[[nodiscard]] std::uint64_t getGeneration() const noexcept { return generation; };
+			/// Get statistics of all bindings.
+			[[nodiscard]] const std::unordered_map<std::string, Binding>& getBindings() const noexcept { return bindings; };
+			/**
+			 * @brief Write report, sorted by total time.
+			 *
+			 * One line per binding with name, number of calls, total, mean, median,
+			 * 99th percentile and maximum (all in nanoseconds), separated by tabs.
+			*/
+			void writeReport(std::ostream& out) const;
+
+			/// Readable name of type (demangled if possible), used to name TypeHelper methods.
+			static std::string typeName(const std::type_info& type);
+		private:
+			std::unordered_map<std::string, Binding> bindings; ///< Statistics by name.
+			std::uint64_t generation = 0; ///< Number of reset() calls.
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -125,7 +125,7 @@ namespace Lua {
 					else {
 							// Function return stuff
 							auto ret = std::apply(doCall, args);
-							return Lp->push(ret);
+							return Lp->push(std::move(ret));
 							}
 					}
 
@@ -151,7 +151,7 @@ namespace Lua {
 					else {
 							// Function return stuff
 							auto ret = std::apply(doCall, args);
-							return Lp->push(ret);
+							return Lp->push(std::move(ret));
 							}
 					}
 
@@ -245,15 +245,41 @@ namespace Lua {
 			friend class TypeCppFunctionWrapper;
 		private:
 			static constexpr const char* tname = "CppFunction";
+
+			/// Contents of userdata.
+			struct FunctionData {
+				CppFunction* func = nullptr;           ///< Function itself (must be first to be found by checkCppType()).
+				std::string* name = nullptr;           ///< Name set by setName() (may be `nullptr`).
+				const CallStats* stats = nullptr;      ///< Statistics `binding` belongs to.
+				std::uint64_t generation = 0;          ///< Generation of `stats` `binding` belongs to.
+				CallStats::Binding* binding = nullptr; ///< Statistics of named function, resolved on first recorded call.
+				};
+
 			static int call(lua_State*);
+			static int callRecorded(lua_State* L, FunctionData& data, StatePtr& Lp, CallStats& stats);
 			static int gc(lua_State*);
 		public:
+			/// Is given C function used to call lua++ bindings (CppFunction or CppFunctionWrapper).
+			static bool isBinding(lua_CFunction func) noexcept;
+			/**
+			 * @brief Set name of function object, used by CallStats.
+			 *
+			 * Unnamed function is recorded by name it was called with.
+			 *
+			 * @param L %Lua state.
+			 * @param idx Index of CppFunction object.
+			 * @param name Name of binding.
+			*/
+			static void setName(lua_State* L, int idx, const std::string& name);
+			/// Name set by setName() (`nullptr` if value isn't named CppFunction object).
+			static const std::string* getName(lua_State* L, int idx) noexcept;
 			/// @copydoc TypeBase::init
 			void init(Lua::State&) const override;
 			[[nodiscard]] const std::type_info& getType() const noexcept override;
 			bool checkType(lua_State*, int) const noexcept override;
 			std::any getValue(lua_State*, int) const override;
 			void pushValue(lua_State*, const std::any&) const override;
+			bool moveValue(lua_State*, const std::any&) const override;
 		};
 
 	/**
@@ -262,6 +288,7 @@ namespace Lua {
 	 * Prefer that one until you MUST have a function for some reason.
 	*/
 	class TypeCppFunctionWrapper: public TypeBase {
+			friend class TypeCppFunction;
 		private:
 			static int call(lua_State*);
 			static constexpr const std::type_info& id = typeid(CppFunctionWrapper);
@@ -275,6 +302,7 @@ namespace Lua {
 			bool checkType(lua_State*, int) const noexcept override;
 			std::any getValue(lua_State*, int) const override;
 			void pushValue(lua_State*, const std::any&) const override;
+			bool moveValue(lua_State*, const std::any&) const override;
 		};
 	};
 // kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4; 
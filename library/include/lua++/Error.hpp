@@ -1,5 +1,8 @@
 #pragma once
+#include <functional>
 #include <stdexcept>
+#include <tuple>
+#include "lua.hpp"
 
 /**
  * @file lua++/Error.hpp
@@ -46,6 +49,47 @@ namespace Lua {
 			explicit SyntaxError(const char* what_arg): Error(what_arg) {};
 		};
 
+	/**
+	 * @brief Class used when %Lua ran out of memory budget.
+	 *
+	 * This exception is thrown instead of `std::bad_alloc` if memory allocation
+	 * was refused by AccountingAllocator because of its limit.
+	*/
+	class MemoryLimitError: public Error {
+		public:
+			/// Usual constructor
+			explicit MemoryLimitError(const std::string& what_arg): Error(what_arg) {};
+			/// Usual constructor
+			explicit MemoryLimitError(const char* what_arg): Error(what_arg) {};
+		};
+
+	/**
+	 * @brief Class used when %Lua call ran out of its execution budget.
+	 *
+	 * This exception is thrown by State::pcall() with CallBudget when instruction
+	 * budget or deadline was exceeded. State stays usable.
+	*/
+	class TimeoutError: public Error {
+		public:
+			/// Usual constructor
+			explicit TimeoutError(const std::string& what_arg): Error(what_arg) {};
+			/// Usual constructor
+			explicit TimeoutError(const char* what_arg): Error(what_arg) {};
+		};
+
+	/**
+	 * @brief Class used when %Lua call was stopped by State::interrupt().
+	 *
+	 * State stays usable after this exception.
+	*/
+	class InterruptedError: public Error {
+		public:
+			/// Usual constructor
+			explicit InterruptedError(const std::string& what_arg): Error(what_arg) {};
+			/// Usual constructor
+			explicit InterruptedError(const char* what_arg): Error(what_arg) {};
+		};
+
 	/**
 	 * @brief Wrap function into `try/catch` block that will rethrow error as %Lua.
 	 *
@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include "lua.hpp"
+
+/**
+ * @file lua++/GarbageCollector.hpp
+ * @brief Control over %Lua garbage collector
+*/
+
+namespace Lua {
+	/**
+	 * @brief Handle controlling garbage collector of State.
+	 *
+	 * Obtained with State::gc(). It's just a pointer to State, so it's cheap to
+	 * copy, but must not outlive State it came from.
+	 *
+	 * To run collection at predictable moments (i.e. between frames) stop automatic
+	 * collector and give it time when there is some to spare:
+	 * ```
+	 * L.gc().stop();
+	 * while (running) {
+	 *     update();
+	 *     render();
+	 *     L.gc().step(frameEnd - std::chrono::steady_clock::now());
+	 *     }
+	 * ```
+	 * Explicit steps are run even when collector is stopped.
+	 *
+	 * @note Memory is still collected in emergency (when allocation fails), even if collector is stopped.
+	*/
+	class GarbageCollector {
+		private:
+			lua_State* state; ///< Main thread of State.
+		public:
+			/// Collector mode.
+			enum class Mode {
+				INCREMENTAL = LUA_GCINC, ///< Classic incremental mark and sweep.
+				GENERATIONAL = LUA_GCGEN ///< Frequent minor collections of young objects.
+				};
+
+			/// Results of stepping.
+			struct StepResult {
+				std::size_t steps = 0;                          ///< Number of basic steps done.
+				std::size_t freed = 0;                          ///< Bytes freed (zero if more was allocated by finalizers).
+				bool cycleFinished = false;                     ///< Was collection cycle completed (incremental mode only).
+				std::chrono::steady_clock::duration elapsed {}; ///< Time spent.
+				};
+
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param L Any thread of State.
+			*/
+			explicit GarbageCollector(lua_State* L) noexcept;
+
+			/**
+			 * @brief Switch to incremental mode and set its parameters.
+			 *
+			 * Zero leaves parameter unchanged.
+			 *
+			 * @param pause How long to wait before starting new cycle (percent of memory in use after last one, default 200).
+			 * @param stepmul Speed of collector relative to allocation (percent, default 100).
+			 * @param stepsize Size of basic step (log2 of bytes, default 13 i.e. 8 KiB).
+			 * @return Previous mode.
+			*/
+			Mode incremental(int pause = 0, int stepmul = 0, int stepsize = 0) noexcept;
+			/**
+			 * @brief Switch to generational mode and set its parameters.
+			 *
+			 * Zero leaves parameter unchanged.
+			 *
+			 * @param minormul Growth of memory (percent since last major collection) triggering minor collection (default 20).
+			 * @param majormul Growth of memory (percent) triggering major collection (default 100).
+			 * @return Previous mode.
+			*/
+			Mode generational(int minormul = 0, int majormul = 0) noexcept;
+
+			/// Run full collection cycle.
+			void collect();
+			/// Stop automatic collection.
+			void stop() noexcept;
+			/// Restart automatic collection.
+			void restart() noexcept;
+			/// Is automatic collection running.
+			[[nodiscard]] bool isRunning() const noexcept;
+			/// Bytes in use by %Lua.
+			[[nodiscard]] std::size_t count() const noexcept;
+
+			/**
+			 * @brief Do amount of work equivalent to allocation of `kbytes` kilobytes.
+			 *
+			 * @param kbytes Work budget (zero for single basic step).
+			 * @return Work done.
+			*/
+			StepResult step(std::size_t kbytes = 0);
+			/**
+			 * @brief Do basic steps until time budget runs out or cycle is finished.
+			 *
+			 * At least one step is done (if budget is positive). Time is checked between
+			 * steps, so budget can be overrun by duration of single step; make steps
+			 * smaller with `stepsize` parameter of incremental() if that's a problem.
+			 *
+			 * In generational mode every step is complete (minor or major) collection
+			 * and cycle is never reported as finished, so whole budget is used.
+			 *
+			 * @param budget Time budget.
+			 * @return Work done.
+			*/
+			StepResult step(std::chrono::steady_clock::duration budget);
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
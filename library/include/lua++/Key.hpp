@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "lua++/Error.hpp"
+
+/**
+ * @file lua++/Key.hpp
+ * @brief Interned table keys and precompiled key paths
+*/
+
+namespace Lua {
+	/**
+	 * @brief String key interned once per State.
+	 *
+	 * When you call `lua_getfield`/`lua_setfield` with C string, %Lua has to
+	 * hash it on every call. Key avoids that: first time it is used in
+	 * State, string is created and saved into registry slot. All futher
+	 * uses just fetch it with `lua_rawgeti` and pass to `lua_rawget`/`lua_rawset`,
+	 * which reuse precomputed hash.
+	 *
+	 * Keys are supposed to be declared once (at namespace scope or as `static` variables):
+	 * ```
+	 * static const Lua::Key maxConn("max_conn");
+	 * L.getField(-1, maxConn);
+	 * ```
+	 *
+	 * @warning Every Key object takes a slot in every State it's used with, so don't
+	 * create them on the fly.
+	 * @warning Name isn't copied, so it must outlive Key (string literals are fine).
+	 * @see State::pushKey(), State::getField(), State::setField()
+	*/
+	class Key {
+		private:
+			std::string_view name; ///< Key string.
+			std::size_t id;        ///< Process-wide unique index of key.
+
+			/// Allocate new id (thread-safe).
+			static std::size_t nextId() noexcept {
+				static std::atomic<std::size_t> counter {0};
+				return counter.fetch_add(1, std::memory_order_relaxed);
+				};
+		public:
+			/// Create key for given string.
+			explicit Key(std::string_view str) noexcept: name(str), id(nextId()) {};
+
+			/// Key string.
+			[[nodiscard]] std::string_view getName() const noexcept { return name; };
+			/// Process-wide unique index of key.
+			[[nodiscard]] std::size_t getId() const noexcept { return id; };
+		};
+
+	/**
+	 * @brief Dot-separated path to nested table field, parsed once.
+	 *
+	 * Path is split into interned keys on construction, so every lookup
+	 * is a chain of `lua_rawget` calls without any parsing or hashing.
+	 *
+	 * ```
+	 * static const Lua::Path maxConn("server.limits.max_conn");
+	 * auto value = L.getPath<Lua::Number>(cfg, maxConn);
+	 * ```
+	 *
+	 * Same warnings as for Key apply: create paths once and reuse them.
+	 * @see State::getPath(), State::pushPath()
+	*/
+	class Path {
+		private:
+			std::shared_ptr<const std::string> source; ///< Path string (on heap to keep keys valid after move/copy).
+			std::vector<Key> keys;                     ///< Keys for every path segment.
+		public:
+			/**
+			 * @brief Parse path.
+			 *
+			 * @param path Dot-separated list of field names.
+			 * @throw Lua::Error Path contains empty segment.
+			*/
+			explicit Path(std::string_view path): source(std::make_shared<const std::string>(path)) {
+				std::string_view rest = *source;
+
+				while (true) {
+						auto pos = rest.find('.');
+						auto segment = rest.substr(0, pos);
+
+						if (segment.empty()) {
+								throw Lua::Error("Empty segment in path \"" + *source + "\"");
+								}
+
+						keys.emplace_back(segment);
+
+						if (pos == std::string_view::npos) break;
+
+						rest.remove_prefix(pos + 1);
+						}
+				};
+
+			/// Keys for every path segment.
+			[[nodiscard]] const std::vector<Key>& getKeys() const noexcept { return keys; };
+			/// Original path string.
+			[[nodiscard]] std::string_view getString() const noexcept { return *source; };
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,80 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * @file lua++/ModuleArchive.hpp
+ * @brief Single-file archive of %Lua modules
+*/
+
+namespace Lua {
+	/**
+	 * @brief Read-only archive of %Lua modules.
+	 *
+	 * Archive is a single file with index of module names sorted bytewise, followed
+	 * by names and chunks (bytecode or source) themselves. It's memory-mapped once
+	 * and module lookup is binary search over index, so loading thousands of modules
+	 * costs no file system calls at all. Use State::addArchive() to serve it with `require`.
+	 *
+	 * Layout (all integers are little-endian):
+	 *
+	 * | Offset      | Size       | Content                                              |
+	 * |-------------|------------|------------------------------------------------------|
+	 * | 0           | 8          | Magic `LUA++AR\0`                                    |
+	 * | 8           | 4          | Format version (1)                                   |
+	 * | 12          | 4          | Number of modules `n`                                |
+	 * | 16          | 32 * `n`   | Entries: name offset, name size, chunk offset, chunk size (64 bit each) |
+	 * | 16 + 32 * n | …          | Names and chunks                                     |
+	 *
+	 * Archives are created with write() or `lua++_pack` tool (see `lua_packarchive` CMake function).
+	 *
+	 * Copies share the same mapping, so object is cheap to copy and thread-safe.
+	 *
+	 * @warning %Lua doesn't verify binary chunks, so only use archives from trusted sources.
+	*/
+	class ModuleArchive {
+		private:
+			std::string filename;                ///< Path to archive.
+			std::shared_ptr<const void> storage; ///< Keeps mapping (or buffer) alive.
+			std::string_view data;               ///< Archive contents.
+			std::size_t count = 0;               ///< Number of modules.
+
+			std::string_view nameAt(std::size_t i) const;  ///< Get name of i-th module.
+			std::string_view chunkAt(std::size_t i) const; ///< Get chunk of i-th module.
+		public:
+			/**
+			 * @brief Open archive.
+			 *
+			 * @param filename Path to archive.
+			 *
+			 * @throw Lua::Error File can't be read or isn't valid archive.
+			*/
+			explicit ModuleArchive(const std::string& filename);
+
+			/**
+			 * @brief Find module.
+			 *
+			 * @param name Module name (as passed to `require`).
+			 * @return Chunk (valid as long as any copy of archive exists) or nothing.
+			*/
+			[[nodiscard]] std::optional<std::string_view> find(std::string_view name) const;
+			/// Number of modules in archive.
+			[[nodiscard]] std::size_t size() const noexcept { return count; };
+			/// Path archive was opened from.
+			[[nodiscard]] const std::string& getFilename() const noexcept { return filename; };
+
+			/**
+			 * @brief Create archive.
+			 *
+			 * @param filename Path to archive (overwritten if exists).
+			 * @param modules Module names mapped to chunks.
+			 *
+			 * @throw Lua::Error Failed to write file.
+			*/
+			static void write(const std::string& filename, const std::map<std::string, std::string>& modules);
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
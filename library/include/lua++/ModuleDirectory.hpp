@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @file lua++/ModuleDirectory.hpp
+ * @brief Indexed directory of %Lua modules
+*/
+
+namespace Lua {
+	/**
+	 * @brief Directory tree of `.lua` modules with in-memory index.
+	 *
+	 * Tree is scanned once and every module name is mapped to its file, same way
+	 * as standard `?.lua;?/init.lua` path does (`a.b` is `a/b.lua` or `a/b/init.lua`,
+	 * former wins). After that, lookups (both successful and failed) cost one hash
+	 * lookup and no system calls. Use State::addDirectory() to serve it with `require`.
+	 *
+	 * Only files inside root are ever served: symbolic links are ignored and module
+	 * names are never turned into paths directly, so `require '..secret'` can't escape.
+	 * This makes it safe replacement for file searchers removed by State::stripPackageLibrary().
+	 *
+	 * Index is not updated automatically. Either call invalidate() after changing
+	 * files or enable watch() (Linux only) to do it on every change in tree.
+	 *
+	 * Object is thread-safe and can be shared between States (use `std::shared_ptr`).
+	*/
+	class ModuleDirectory {
+		private:
+			std::filesystem::path root;                         ///< Root of tree.
+
+			mutable std::mutex mutex;                           ///< Protects fields below.
+			std::unordered_map<std::string, std::string> index; ///< Module name to file path.
+			std::atomic<bool> stale {false};                    ///< Index must be rebuilt before next lookup.
+
+			int inotifyFd = -1;                                 ///< inotify instance (-1 if not watching).
+			int stopFd[2] = {-1, -1};                           ///< Pipe used to stop watcher thread.
+			std::thread watcher;                                ///< Thread waiting for inotify events.
+
+			void rebuild();                                     ///< Scan tree (lock must be held).
+			void watchLoop();                                   ///< Body of watcher thread.
+		public:
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param root Root directory of module tree.
+			 *
+			 * @throw Lua::Error Root is not a directory.
+			*/
+			explicit ModuleDirectory(std::filesystem::path root);
+			ModuleDirectory(const ModuleDirectory&) = delete; ///< Explicitly deleted to prevent copy.
+			ModuleDirectory& operator=(const ModuleDirectory&) = delete; ///< Explicitly deleted to prevent copy.
+			~ModuleDirectory(); ///< Stop watcher, if any.
+
+			/**
+			 * @brief Find module file.
+			 *
+			 * @param name Module name (as passed to `require`).
+			 * @return Path to module or nothing.
+			*/
+			[[nodiscard]] std::optional<std::string> find(std::string_view name);
+			/// Rescan tree before next lookup.
+			void invalidate() noexcept { stale = true; };
+			/// Rescan tree right now.
+			void refresh();
+			/**
+			 * @brief Invalidate index automatically when files are added, removed or renamed.
+			 *
+			 * Starts thread waiting for inotify events. Lookups still do no system calls.
+			 *
+			 * @return Was watcher started (false on systems without inotify or on failure).
+			*/
+			bool watch();
+
+			/// Number of known modules.
+			[[nodiscard]] std::size_t size() const;
+			/// Root of tree.
+			[[nodiscard]] const std::filesystem::path& getRoot() const noexcept { return root; };
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
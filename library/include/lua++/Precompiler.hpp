@@ -0,0 +1,108 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <vector>
+#include "lua++/State.hpp"
+#include "lua++/Error.hpp"
+
+/**
+ * @file lua++/Precompiler.hpp
+ * @brief Parallel compilation of many %Lua chunks
+*/
+
+namespace Lua {
+	/**
+	 * @brief Batch of chunks to be compiled on several threads.
+	 *
+	 * When lots of scripts are loaded on startup, parsing dominates. Precompiler
+	 * spreads batch between worker threads, each of them compiles chunks in its own
+	 * throwaway State and dumps them with `lua_dump`. Bytecode is then loaded into
+	 * target State in binary mode, which skips parser completely.
+	 *
+	 * ```
+	 * Lua::Precompiler batch;
+	 *
+	 * for (const auto& path : modules) {
+	 *     batch.addFile(path);
+	 *     }
+	 *
+	 * for (const auto& chunk : batch.run()) {
+	 *     chunk.load(L); // Throws Lua::SyntaxError if this one failed to compile
+	 *     L.pcall(0, 0);
+	 *     }
+	 * ```
+	 *
+	 * Results may also be handed to State::addPreloadedChunk() (keep vector alive then).
+	 *
+	 * @note run() is `const` and may be called from many threads at once.
+	*/
+	class Precompiler {
+		public:
+			/// Compilation result for single chunk.
+			struct Result {
+				std::string name;                 ///< Chunk name.
+				std::string bytecode;             ///< Compiled chunk (empty on failure).
+				std::optional<SyntaxError> error; ///< Error, if chunk failed to compile.
+
+				/// Was chunk compiled successfully.
+				[[nodiscard]] bool ok() const noexcept { return !error; };
+				/**
+				 * @brief Load chunk into State in binary mode.
+				 *
+				 * @throw Lua::SyntaxError Chunk failed to compile (same error State::load would throw).
+				 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+				*/
+				void load(State& L) const;
+				};
+
+		private:
+			/// Chunk to be compiled.
+			struct Input {
+				std::string name;   ///< Chunk name.
+				std::string source; ///< Source code or file name.
+				bool isFile;        ///< Should `source` be passed to State::loadFile().
+				};
+
+			std::vector<Input> inputs; ///< Chunks in order they were added.
+			bool stripDebug;           ///< Strip debug info from bytecode.
+		public:
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param strip Strip debug information from bytecode (smaller, but error
+			 * messages lose line numbers).
+			*/
+			explicit Precompiler(bool strip = false): stripDebug(strip) {};
+
+			/**
+			 * @brief Add chunk from string.
+			 *
+			 * @param code %Lua source code.
+			 * @param name Chunk name (see State::load()).
+			*/
+			Precompiler& addSource(std::string code, std::string name = "Lua::State::load");
+			/**
+			 * @brief Add chunk from file.
+			 *
+			 * File is read by worker thread with State::loadFile(), so same rules apply.
+			 * Chunk name is `@filename`.
+			*/
+			Precompiler& addFile(const std::string& filename);
+			/// Number of chunks in batch.
+			[[nodiscard]] std::size_t size() const noexcept { return inputs.size(); };
+
+			/**
+			 * @brief Compile all chunks.
+			 *
+			 * Syntax errors don't stop compilation, they are reported in corresponding
+			 * Result instead.
+			 *
+			 * @param threads Number of threads to use (current one included). Zero means
+			 * `std::thread::hardware_concurrency()`.
+			 * @return One result per chunk, in order they were added.
+			 * @throw std::bad_alloc Out of memory in one of workers.
+			*/
+			std::vector<Result> run(unsigned threads = 0) const;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
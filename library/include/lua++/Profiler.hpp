@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include "lua.hpp"
+
+/**
+ * @file lua++/Profiler.hpp
+ * @brief Sampling profiler for %Lua code
+*/
+
+namespace Lua {
+	/**
+	 * @brief Sampling profiler producing folded stacks.
+	 *
+	 * Normally controlled by State::startProfiler() and friends: count hook checks
+	 * clock every few instructions and, once sampling interval passes, stack of
+	 * running thread is recorded. Report is in "folded stacks" format, accepted by
+	 * `flamegraph.pl` and most other flame graph tools:
+	 *
+	 * ```
+	 * L.startProfiler();
+	 * …
+	 * L.stopProfiler();
+	 * std::ofstream out("lua.folded");
+	 * L.getProfiler()->writeFolded(out);
+	 * ```
+	 *
+	 * Frames are named `name (source:line)` for %Lua functions, `name [C++]` for
+	 * lua++ bindings (CppFunction and CppFunctionWrapper) and `name [C]` for other
+	 * C functions. Name is one function was called by (global, field or method name),
+	 * as in %Lua tracebacks; bindings named for CallStats (TypeHelper methods, i.e.
+	 * `Type:method`) use that name instead. Count hooks only run in %Lua code, so
+	 * binding also checks whether sample is due once it returns: time spent in C++
+	 * is charged to it, not to its caller.
+	 *
+	 * @note Only stack of running coroutine is recorded, not one of code that resumed it.
+	*/
+	class Profiler {
+		private:
+			std::chrono::steady_clock::duration interval;           ///< Time between samples.
+			std::chrono::steady_clock::time_point nextSample;       ///< When to take next sample.
+			std::unordered_map<std::string, std::size_t> stacks;   ///< Folded stack to number of samples.
+			std::size_t samples = 0;                                ///< Total number of samples.
+			std::size_t maxDepth;                                   ///< Frames deeper than this are dropped.
+		public:
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param interval Time between samples.
+			 * @param maxDepth Maximum number of frames recorded (innermost ones are kept).
+			*/
+			explicit Profiler(std::chrono::steady_clock::duration interval = std::chrono::milliseconds(1), std::size_t maxDepth = 64);
+
+			/**
+			 * @brief Check whether sample should be taken now.
+			 *
+			 * If so, schedules next one.
+			*/
+			bool due() noexcept;
+			/**
+			 * @brief Record stack of given thread.
+			 *
+			 * Safe to call from hook; sample is dropped if memory is exhausted.
+			*/
+			void sample(lua_State* L) noexcept;
+			/// Forget all samples.
+			void reset() noexcept;
+			/// Change time between samples.
+			void setInterval(std::chrono::steady_clock::duration newInterval) noexcept { interval = newInterval; };
+
+			/// Write report in folded stacks format (one `frame;frame;frame count` line per stack).
+			void writeFolded(std::ostream& out) const;
+			/// Get report in folded stacks format.
+			[[nodiscard]] std::string folded() const;
+			/// Get recorded stacks (folded stack to number of samples).
+			[[nodiscard]] const std::unordered_map<std::string, std::size_t>& getStacks() const noexcept { return stacks; };
+			/// Total number of samples.
+			[[nodiscard]] std::size_t getSampleCount() const noexcept { return samples; };
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
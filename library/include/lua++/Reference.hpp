@@ -0,0 +1,78 @@
+#pragma once
+#include "lua.hpp"
+
+/**
+ * @file lua++/Reference.hpp
+ * @brief RAII handle for values stored in %Lua registry
+*/
+
+namespace Lua {
+	/**
+	 * @brief Handle for %Lua value stored in registry.
+	 *
+	 * This is a RAII wrapper around `luaL_ref`/`luaL_unref`. It allows
+	 * C++ side to keep values which have no C++ representation (tables,
+	 * functions, full userdata, threads) alive between calls.
+	 *
+	 * Copying a reference creates new registry slot pointing at same value.
+	 *
+	 * @warning Reference must not outlive State it was created in.
+	 * @note Reference is always bound to main thread, so it's safe to create it
+	 * from coroutine and use it after coroutine is gone.
+	*/
+	class Reference {
+		private:
+			lua_State* L = nullptr; ///< Main thread of state reference belongs to.
+			int ref = LUA_NOREF;    ///< Index in registry.
+
+			static lua_State* getMainThread(lua_State* L); ///< Get main thread for any %Lua thread.
+		public:
+			/// Create empty reference.
+			Reference() = default;
+			/**
+			 * @brief Create reference to value on %Lua stack.
+			 *
+			 * Value is not popped from stack.
+			 *
+			 * @param L %Lua state (or any of its threads) value is located in.
+			 * @param idx Index of value on %Lua stack.
+			*/
+			Reference(lua_State* L, int idx);
+			Reference(const Reference&); ///< Create new reference to same value.
+			Reference(Reference&& old) noexcept; ///< Move constructor.
+			Reference& operator=(const Reference&); ///< Create new reference to same value.
+			Reference& operator=(Reference&& old) noexcept; ///< Move assignment.
+			~Reference(); ///< Release registry slot.
+
+			/**
+			 * @brief Push referenced value onto %Lua stack.
+			 *
+			 * Empty reference will push `nil`.
+			 *
+			 * @param to %Lua thread to push value onto. Must belong to same state.
+			 * @return %Lua type of pushed value.
+			*/
+			int push(lua_State* to) const;
+			/**
+			 * @brief Get %Lua type of referenced value.
+			 *
+			 * Value is fetched from registry using main thread stack.
+			 *
+			 * @return %Lua type (`LUA_TNIL` for empty reference, `LUA_TNONE` if there is no stack space to check).
+			*/
+			[[nodiscard]] int getType() const noexcept;
+
+			/// Release registry slot and make reference empty.
+			void reset() noexcept;
+
+			/// Does reference point to non-`nil` value.
+			[[nodiscard]] bool valid() const noexcept { return L and ref != LUA_NOREF and ref != LUA_REFNIL; };
+			/// Same as valid().
+			explicit operator bool() const noexcept { return valid(); };
+			/// Index in registry (either real one, `LUA_NOREF` or `LUA_REFNIL`).
+			[[nodiscard]] int getRef() const noexcept { return ref; };
+			/// Main thread of state reference belongs to (`nullptr` for empty reference).
+			[[nodiscard]] lua_State* getState() const noexcept { return L; };
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,169 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "lua++/State.hpp"
+
+/**
+ * @file lua++/Scheduler.hpp
+ * @brief Preemptive scheduler for %Lua tasks
+*/
+
+namespace Lua {
+	/**
+	 * @brief Runs many %Lua tasks in one State, preempting ones that run too long.
+	 *
+	 * Every task is a %Lua thread (coroutine). It's resumed for one time slice and
+	 * count hook yields it once slice is over, so task spinning in `while true do end`
+	 * can't starve others. Tasks may also give up the rest of their slice with
+	 * `coroutine.yield()` (yielded values are discarded).
+	 *
+	 * Next task is picked by its virtual runtime: time spent running divided by priority.
+	 * So task with priority 2 gets twice as much time as task with priority 1, and
+	 * new task never has to wait for older ones to catch up.
+	 *
+	 * Task is only preempted where %Lua allows yielding. While it's inside C++ binding
+	 * (or any other C function, i.e. `table.sort` comparator), hook waits for it to return,
+	 * so bindings never see task suspended in the middle of call and StatePtr works as usual.
+	 * Coroutines resumed by task with `coroutine` library are preempted too: their yield
+	 * is passed up to task thread (and then undone when task is resumed), so task can't
+	 * escape preemption by spinning inside coroutine. Coroutines resumed by C++ code
+	 * with plain `lua_resume` are not preempted.
+	 * State::interrupt() stops only task being run (it fails with error).
+	 *
+	 * ```
+	 * Lua::Scheduler sched(L);
+	 * for (auto& script : scripts) {
+	 *     L.load(script);
+	 *     sched.spawn(0);
+	 *     }
+	 * sched.run();
+	 * ```
+	 *
+	 * @note Like State itself, scheduler is not thread-safe. To use several threads,
+	 * give each one own State and scheduler.
+	 * @warning Scheduler must not outlive State.
+	*/
+	class Scheduler {
+		public:
+			/// Task identifier (never reused by same scheduler).
+			using TaskId = std::uint64_t;
+
+			/// Task state.
+			enum class Status {
+				READY,    ///< Waiting for its turn.
+				RUNNING,  ///< Being run right now.
+				FINISHED, ///< Function returned.
+				FAILED,   ///< Function raised error.
+				CANCELLED ///< Removed by cancel().
+				};
+
+			/// Task statistics.
+			struct TaskInfo {
+				TaskId id = 0;                                     ///< Task identifier.
+				int priority = 1;                                  ///< Priority (relative share of time).
+				Status status = Status::READY;                     ///< Task state.
+				std::chrono::steady_clock::duration cpuTime {};    ///< Total time spent running.
+				std::size_t slices = 0;                            ///< Number of times task was resumed.
+				std::size_t preemptions = 0;                       ///< Number of times task was preempted.
+				std::optional<std::string> error;                  ///< Error message (for failed task).
+				};
+
+			/// Function to be called when task is done (finished, failed or cancelled).
+			using CompletionHandler = std::function<void(const TaskInfo&)>;
+
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param L State to run tasks in.
+			 * @param slice Time slice length.
+			 * @param granularity Instructions between clock checks (task may overrun slice by that much).
+			*/
+			explicit Scheduler(State& L, std::chrono::steady_clock::duration slice = std::chrono::milliseconds(1), int granularity = 1000);
+			Scheduler(const Scheduler&) = delete; ///< Explicitly deleted to prevent copy.
+			Scheduler& operator=(const Scheduler&) = delete; ///< Explicitly deleted to prevent copy.
+			~Scheduler(); ///< Release all tasks (without running them).
+
+			/**
+			 * @brief Create new task.
+			 *
+			 * %Lua stack before call:
+			 * ```
+			 * xxx | func | arg1 | arg2
+			 * ```
+			 * Function and arguments are popped.
+			 *
+			 * @param nargs Amount of arguments.
+			 * @param priority Priority of task (at least 1).
+			 * @return Task identifier.
+			*/
+			TaskId spawn(int nargs, int priority = 1);
+			/**
+			 * @brief Run one slice of task with lowest virtual runtime.
+			 *
+			 * @return Are there tasks ready to run.
+			*/
+			bool runOnce();
+			/// Run until there are no tasks left.
+			void run();
+			/**
+			 * @brief Run slices until time budget runs out or there are no tasks left.
+			 *
+			 * @param budget Time budget.
+			 * @return Number of slices run.
+			*/
+			std::size_t runFor(std::chrono::steady_clock::duration budget);
+
+			/**
+			 * @brief Remove task without running it any more.
+			 *
+			 * Its pending to-be-closed variables are closed. Task can't cancel itself.
+			 *
+			 * @return Was task found (and not running).
+			*/
+			bool cancel(TaskId id);
+			/**
+			 * @brief Change priority of task.
+			 *
+			 * @return Was task found.
+			*/
+			bool setPriority(TaskId id, int priority);
+			/// Get statistics of active task.
+			[[nodiscard]] std::optional<TaskInfo> getInfo(TaskId id) const;
+			/// Number of active tasks.
+			[[nodiscard]] std::size_t size() const noexcept { return tasks.size(); };
+			/// Set function to be called when task is done.
+			void setCompletionHandler(CompletionHandler handler) { onComplete = std::move(handler); };
+		private:
+			/// Task data.
+			struct Task {
+				TaskInfo info;           ///< Statistics.
+				lua_State* thread;       ///< %Lua thread.
+				int ref;                 ///< Registry slot keeping thread alive.
+				int pendingArgs;         ///< Arguments for first resume.
+				std::int64_t vruntime;   ///< Virtual runtime (nanoseconds).
+				};
+
+			State& L;                                               ///< State running tasks.
+			std::chrono::steady_clock::duration slice;              ///< Time slice length.
+			int granularity;                                        ///< Hook count.
+			std::unordered_map<TaskId, Task> tasks;                 ///< Active tasks.
+			std::set<std::pair<std::int64_t, TaskId>> ready;        ///< Ready tasks, by virtual runtime.
+			TaskId nextId = 1;                                      ///< Identifier of next task.
+			std::int64_t minVruntime = 0;                           ///< Virtual runtime of last picked task.
+			CompletionHandler onComplete;                           ///< Called when task is done.
+
+			Task* current = nullptr;                                ///< Task being run.
+			std::chrono::steady_clock::time_point sliceEnd;         ///< End of current slice.
+			bool preempted = false;                                 ///< Was current task yielded by hook.
+
+			void finish(TaskId id, Status status, std::optional<std::string> error = std::nullopt); ///< Remove task and report it.
+			static void preemptHook(lua_State* thread, lua_Debug*); ///< Count hook yielding current task.
+			bool canForwardYield(lua_State* thread) const; ///< Can yield of coroutine resumed by current task be passed up to it.
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <unordered_map>
 #include <vector>
 #include <typeindex>
@@ -7,6 +9,12 @@
 #include <functional>
 
 #include "lua++/Type.hpp"
+#include "lua++/Value.hpp"
+#include "lua++/Key.hpp"
+#include "lua++/Allocator.hpp"
+#include "lua++/GarbageCollector.hpp"
+#include "lua++/Profiler.hpp"
+#include "lua++/CallStats.hpp"
 #include "lua.hpp"
 
 /**
@@ -16,6 +24,10 @@
 
 namespace Lua {
 	class StatePtr;
+	class BytecodeCache;
+	class ModuleArchive;
+	class ModuleDirectory;
+	template<typename T> class StackDecoder;
 
 	/// Alias for `std::function<int(Lua::StatePtr&)>` AKA C++ version of `lua_CFunction`.
 	using CppFunction = std::function<int(StatePtr&)>;
@@ -64,6 +76,36 @@ namespace Lua {
 		BOTH ///< Both text and binary chunks
 		};
 
+	/**
+	 * @brief Execution limits for State::pcall().
+	 *
+	 * Checked by count hook every `granularity` instructions, so overhead is low but
+	 * limits are enforced with that precision (and time spent inside single C function
+	 * is never interrupted).
+	 *
+	 * ```
+	 * L.pcall(0, 0, Lua::CallBudget::timeout(std::chrono::milliseconds(50)));
+	 * ```
+	*/
+	struct CallBudget {
+		std::size_t instructions = 0;                                     ///< Instruction budget (zero for unlimited).
+		std::optional<std::chrono::steady_clock::time_point> deadline;    ///< Wall-clock deadline (none for unlimited).
+		int granularity = 1000;                                           ///< Instructions between checks.
+
+		/// Budget with deadline `duration` from now.
+		static CallBudget timeout(std::chrono::steady_clock::duration duration) {
+			CallBudget res;
+			res.deadline = std::chrono::steady_clock::now() + duration;
+			return res;
+			};
+		/// Budget of `count` instructions.
+		static CallBudget steps(std::size_t count) {
+			CallBudget res;
+			res.instructions = count;
+			return res;
+			};
+		};
+
 	/**
 	 * @brief %Lua state manager
 	 *
@@ -80,6 +122,9 @@ namespace Lua {
 	*/
 	class State {
 			friend class StatePtr;
+			friend class Scheduler;
+			friend class TypeCppFunction;
+			template<typename T> friend class StackDecoder;
 		private:
 			/**
 			 * @brief Internally used function for loading %Lua code.
@@ -92,9 +137,18 @@ namespace Lua {
 			 *
 			 * @throw Lua::SyntaxError %Lua parser failed to load chunk (`LUA_ERRSYNTAX`).
 			 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+			 * @throw Lua::MemoryLimitError Memory limit was hit (see AccountingAllocator).
 			*/
 			template<typename T>
 			void loadInternal(T& reader, const std::string& name, LoadMode mode);
+			/**
+			 * @brief Load chunk from memory, using bytecode cache if it's set.
+			 *
+			 * @param data Chunk itself.
+			 * @param name Chunk name to be passed to %Lua directly.
+			 * @param mode Loading mode.
+			*/
+			void loadBuffer(std::string_view data, const std::string& name, LoadMode mode);
 
 			template <typename> struct is_tuple: std::false_type {};
 			template <typename ...T> struct is_tuple<std::tuple<T...>>: std::true_type {};
@@ -108,6 +162,70 @@ namespace Lua {
 			std::vector<std::shared_ptr<TypeBase>> knownTypesList; ///< List of all registered handlers.
 
 			State** luaStatePtr = nullptr; ///< Location of pointer to this State to be used by getFromLuaState.
+			std::vector<int> keySlots; ///< Registry slots of interned keys, indexed by Key::getId().
+			int baselineRef = LUA_NOREF; ///< Registry slot of snapshot saved by saveBaseline().
+			std::shared_ptr<BytecodeCache> bytecodeCache; ///< Cache used by load functions (may be empty).
+			std::unique_ptr<Allocator> allocator; ///< Allocator owned by this State (may be empty).
+
+			/// Budget of call being run by pcall() (with progress).
+			struct ActiveBudget {
+				CallBudget limits;         ///< Limits.
+				std::size_t used = 0;      ///< Instructions executed (with granularity precision).
+				bool exhausted = false;    ///< Was budget exceeded.
+				int count = 0;             ///< Hook count.
+				};
+			ActiveBudget* activeBudget = nullptr; ///< Budget of innermost limited pcall() (if any).
+
+			lua_Hook threadHook = nullptr; ///< Count hook for entered threads (set by Scheduler while task runs).
+			int threadHookCount = 0; ///< Count for `threadHook`.
+			bool forwardYield = false; ///< Was coroutine yielded by `threadHook`, so its resumer must yield too.
+
+			std::unique_ptr<Profiler> profiler; ///< Profiler data (empty if never started).
+			bool profiling = false; ///< Is profiler running.
+
+			std::unique_ptr<CallStats> callStats; ///< Binding statistics (empty if never enabled).
+			bool callStatsEnabled = false; ///< Are binding calls recorded.
+
+			/// Hook of thread, saved to be restored later.
+			struct SavedHook {
+				lua_Hook hook = nullptr; ///< Hook function.
+				int mask = 0;            ///< Hook mask.
+				int count = 0;           ///< Hook count.
+
+				static SavedHook of(lua_State* L) noexcept { return {lua_gethook(L), lua_gethookmask(L), lua_gethookcount(L)}; };
+				void restore(lua_State* L) const noexcept { lua_sethook(L, hook, mask, count); };
+				bool operator==(const SavedHook& other) const noexcept { return hook == other.hook and mask == other.mask and count == other.count; };
+				bool operator!=(const SavedHook& other) const noexcept { return !(*this == other); };
+				};
+			/**
+			 * @brief Thread running %Lua code right now: main one, one entered by StatePtr or coroutine resumed from %Lua.
+			 *
+			 * Entries live on C++ stack (in StatePtr and ThreadScope) and are only touched by thread
+			 * using State. interrupt() only sees innermost thread through `publishedThread`.
+			*/
+			struct RunningThread {
+				lua_State* thread = nullptr;       ///< %Lua thread (`nullptr` if entry isn't used).
+				bool resumed = false;              ///< Was thread resumed by `coroutine` library.
+				SavedHook entered;                 ///< Hook thread had before enterThread() (restored by leaveThread()).
+				SavedHook hook;                    ///< Hook thread has while running (unless replaced by interrupt()).
+				RunningThread* previous = nullptr; ///< Thread it was entered from.
+				};
+			/// Marks thread as running for its lifetime (see enterThread()).
+			struct ThreadScope {
+				State& L;              ///< State thread belongs to.
+				RunningThread running; ///< Entry of thread.
+
+				ThreadScope(State& state, lua_State* L, bool resumed);
+				~ThreadScope();
+				};
+
+			RunningThread mainThread; ///< Entry of main thread (outermost one).
+			RunningThread* runningThread = &mainThread; ///< Innermost running thread.
+			std::atomic<lua_State*> publishedThread = nullptr; ///< Innermost running thread, as seen by interrupt().
+			std::atomic<int> interruptsInProgress = 0; ///< Number of interrupt() calls hooking `publishedThread` right now.
+			std::atomic<bool> interruptPending = false; ///< Was interrupt() called and not cleared yet.
+			bool interruptRaised = false; ///< Was error raised by interrupt() hook.
+			int pcallDepth = 0; ///< Number of running pcall() calls.
 
 			std::stringstream warnBuf; ///< Buffer for accumulating warning message parts.
 			std::function<void(const std::string&)> warnFunc; ///< Function to be called on warning message.
@@ -143,10 +261,53 @@ namespace Lua {
 			 * @throw Lua::StateError with description of error
 			*/
 			[[noreturn]] void throwLuaError();
+			/**
+			 * @brief Turn `LUA_ERRMEM` into C++ exception.
+			 *
+			 * @throw Lua::MemoryLimitError Allocation was refused by AccountingAllocator limit.
+			 * @throw std::bad_alloc Otherwise.
+			*/
+			[[noreturn]] void throwMemoryError();
 
 			static void warnHandler(void* ud, const char* msg, int tocont); ///< Append message to buffer and/or call user warning handler
+			static void budgetHook(lua_State* L, lua_Debug*); ///< Count hook enforcing activeBudget
+			static void interruptHook(lua_State* L, lua_Debug*); ///< Hook installed by interrupt()
+			static int resumeWrapper(lua_State* L); ///< `coroutine.resume` replacement (upvalue: original one)
+			static int wrapWrapper(lua_State* L); ///< `coroutine.wrap` replacement (upvalue: original one)
+			static int wrappedCall(lua_State* L); ///< Function returned by wrapWrapper() (upvalue: function made by original `coroutine.wrap`)
+			static int resumeTracked(lua_State* L, int status, lua_KContext passThread); ///< Common part of resumeWrapper() and wrappedCall()
+			static void profilerHook(lua_State* L, lua_Debug*); ///< Count hook installed by startProfiler()
+			static void profilerTick(lua_State* L); ///< Take sample if it's due (called by all lua++ count hooks)
+
+			/**
+			 * @brief Mark thread as running.
+			 *
+			 * Thread gets hooks required right now (ones of interrupt(), pcall() with
+			 * CallBudget or Scheduler), so code running there can't escape them. Must
+			 * be paired with leaveThread().
+			 *
+			 * @param running Entry to be filled (must live until leaveThread()).
+			 * @param L Thread.
+			 * @param resumed Is thread resumed by `coroutine` library.
+			*/
+			void enterThread(RunningThread& running, lua_State* L, bool resumed) noexcept;
+			void leaveThread(RunningThread& running) noexcept; ///< Mark thread as no longer running and restore its hook.
+			void publishThread(lua_State* L) noexcept; ///< Make thread innermost one for interrupt() (and hook it if interruption is pending).
+			void waitForInterrupts() const noexcept; ///< Wait for interrupt() calls that may still be hooking thread they have seen.
+			/**
+			 * @brief Set hook of thread without losing interruption.
+			 *
+			 * All hook changes made while %Lua code may be running must use it: if thread
+			 * is running, hook is remembered to be restored by clearInterrupt() and
+			 * interruptHook is put back if interrupt() was called meanwhile.
+			*/
+			void setHook(lua_State* L, lua_Hook hook, int mask, int count) noexcept;
+			SavedHook getHook(lua_State* L) const noexcept; ///< Hook of thread, not counting one installed by interrupt().
+			static void hookInterrupt(lua_State* L) noexcept; ///< Install interruptHook on thread.
 
 			bool loadPackageTables(); ///< Push `package.loaded`, `package` onto stack or return false
+			bool appendSearcher(const CppFunction& searcher); ///< Append function to `package.searchers`
+			void internKey(const Key& key); ///< Slow path of pushKey(): create string and save it into registry.
 		public:
 			/**
 			 * @brief Get State object from `lua_State*`.
@@ -167,8 +328,23 @@ namespace Lua {
 			 * @param openlibs Check out DefaultLibsPreset description to know what different values do.
 			 * @param alloc Custom memory allocator (useful for limiting memory usage). Read %Lua docs for details on it.
 			 * @param ud User data for custom memory allocator.
+			 * @param lazyLibs Open libraries on first access instead of right away (see loadDefaultLibLazy()).
+			*/
+			State(DefaultLibsPreset openlibs = DefaultLibsPreset::SAFE_WITH_PACKAGE, lua_Alloc alloc = nullptr, void* ud = nullptr, bool lazyLibs = false);
+			/**
+			 * @brief Constructor with allocator owned by State.
+			 *
+			 * Allocator is used for all %Lua memory and destroyed after `lua_close`.
+			 *
+			 * ```
+			 * Lua::State L(Lua::DefaultLibsPreset::SAFE, std::make_unique<Lua::PoolAllocator>());
+			 * ```
+			 *
+			 * @param openlibs Check out DefaultLibsPreset description to know what different values do.
+			 * @param alloc Allocator to be used (default one if empty).
+			 * @param lazyLibs Open libraries on first access instead of right away (see loadDefaultLibLazy()).
 			*/
-			State(DefaultLibsPreset openlibs = DefaultLibsPreset::SAFE_WITH_PACKAGE, lua_Alloc alloc = nullptr, void* ud = nullptr);
+			State(DefaultLibsPreset openlibs, std::unique_ptr<Allocator> alloc, bool lazyLibs = false);
 			State(const State&) = delete; ///< Explicitly deleted to prevent copy.
 			State& operator=(State&) = delete; ///< Explicitly deleted to prevent copy.
 			/// Move constructor.
@@ -178,6 +354,24 @@ namespace Lua {
 				knownTypes(std::move(old.knownTypes)),
 				knownTypesList(std::move(old.knownTypesList)),
 				luaStatePtr(old.luaStatePtr),
+				keySlots(std::move(old.keySlots)),
+				baselineRef(old.baselineRef),
+				bytecodeCache(std::move(old.bytecodeCache)),
+				allocator(std::move(old.allocator)),
+				activeBudget(old.activeBudget),
+				threadHook(old.threadHook),
+				threadHookCount(old.threadHookCount),
+				forwardYield(old.forwardYield),
+				profiler(std::move(old.profiler)),
+				profiling(old.profiling),
+				callStats(std::move(old.callStats)),
+				callStatsEnabled(old.callStatsEnabled),
+				mainThread(old.mainThread),
+				runningThread(old.runningThread == &old.mainThread ? &mainThread : old.runningThread),
+				publishedThread(old.publishedThread.load()),
+				interruptPending(old.interruptPending.load()),
+				interruptRaised(old.interruptRaised),
+				pcallDepth(old.pcallDepth),
 				warnBuf(std::move(old.warnBuf)),
 				warnFunc(std::move(old.warnFunc)) {
 				// To avoid double-free and fail on misuse
@@ -222,8 +416,33 @@ namespace Lua {
 			 * is returned.
 			 * @throw StateError Call resulted in `LUA_ERRRUN` (calls throwLuaError() to form a message).
 			 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+			 * @throw Lua::MemoryLimitError Memory limit was hit (see AccountingAllocator).
+			 * @throw Lua::InterruptedError Call was stopped by interrupt().
 			*/
 			int pcall(int nargs, std::optional<int> nres = std::nullopt);
+			/**
+			 * @brief Perform protected call to %Lua with execution limits.
+			 *
+			 * Same as pcall(int, std::optional<int>), but call is aborted with %Lua error
+			 * once budget is exhausted. From that point, error is raised on every instruction,
+			 * so script can't keep running by catching it with `pcall`. Hook is removed after
+			 * call and State can be used again.
+			 *
+			 * Limits also apply to coroutines resumed during call with `coroutine` library,
+			 * including ones created earlier (but not ones resumed by C++ code with plain
+			 * `lua_resume`).
+			 *
+			 * @param nargs Amount of argument function takes.
+			 * @param nres If provided, amount of results on stack as result of succesful call.
+			 * @param budget Execution limits.
+			 * @return Amount of arguments left on stack after call.
+			 * @throw Lua::TimeoutError Budget was exhausted.
+			 * @throw Lua::InterruptedError Call was stopped by interrupt().
+			 * @throw StateError Call resulted in `LUA_ERRRUN`.
+			 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+			 * @throw Lua::MemoryLimitError Memory limit was hit (see AccountingAllocator).
+			*/
+			int pcall(int nargs, std::optional<int> nres, const CallBudget& budget);
 			/**
 			 * @brief Load %Lua code from input stream.
 			 *
@@ -246,6 +465,7 @@ namespace Lua {
 			 *
 			 * @throw Lua::SyntaxError %Lua parser failed to load chunk (`LUA_ERRSYNTAX`).
 			 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+			 * @throw Lua::MemoryLimitError Memory limit was hit (see AccountingAllocator).
 			*/
 			void load(std::istream& istr, const std::string& name = "Lua::State::load", LoadMode mode = LoadMode::TEXT);
 			/**
@@ -255,18 +475,34 @@ namespace Lua {
 			 * so it is far more efficient on large strings (but not streams!)
 			 * than `std::stringstream`.
 			 *
-			 * @param str String to be compiled.
+			 * @param code String to be compiled.
+			 * @param name Chunk name to be used in messages. Name beginning with `@` will
+			 * make it appear as file, `=` will make it appear verbatim.
 			 * @param mode Optionally, mode can be set. By default, only text chunks are
 			 * allowed for security reasons.
 			 *
 			 * @throw Lua::SyntaxError %Lua parser failed to load chunk (`LUA_ERRSYNTAX`).
 			 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+			 * @throw Lua::MemoryLimitError Memory limit was hit (see AccountingAllocator).
+			*/
+			void load(std::string_view code, std::string_view name, LoadMode mode = LoadMode::TEXT);
+			/**
+			 * @brief Load %Lua code from string with default chunk name.
+			 *
+			 * Same as `load(code, "Lua::State::load", mode)`. Source itself is never
+			 * used as chunk name, so it isn't copied into function prototypes and
+			 * error messages.
 			*/
-			void load(const std::string& str, LoadMode mode = LoadMode::TEXT);
+			void load(std::string_view code, LoadMode mode = LoadMode::TEXT) { load(code, "Lua::State::load", mode); };
 			/**
 			 * @brief Simple wrapper around State::load to load files.
 			 *
+			 * Regular files are memory-mapped and passed to %Lua in one piece, other
+			 * files (pipes, devices) are read through large buffer. As with `luaL_loadfile`,
+			 * UTF-8 BOM and first line comment (shebang) are skipped.
+			 *
 			 * @note If file does not exist, empty function will be created.
+			 * @warning File must not be truncated while it's being loaded.
 			 *
 			 * @param filename Path to file being loaded.
 			 * @param mode Optionally, mode can be set. By default, only text chunks are
@@ -274,8 +510,31 @@ namespace Lua {
 			 *
 			 * @throw Lua::SyntaxError %Lua parser failed to load chunk (`LUA_ERRSYNTAX`).
 			 * @throw std::bad_alloc Call resulted in `LUA_ERRMEM`.
+			 * @throw Lua::MemoryLimitError Memory limit was hit (see AccountingAllocator).
 			*/
 			void loadFile(const std::string& filename, LoadMode mode = LoadMode::TEXT);
+			/**
+			 * @brief Dump function on top of stack into binary chunk.
+			 *
+			 * This is a wrapper around `lua_dump`. Function is left on stack.
+			 * Result can be loaded back with `LoadMode::BINARY` or `LoadMode::BOTH`.
+			 *
+			 * @param strip Strip debug information (line numbers, local names, source).
+			 * @return Binary chunk.
+			 * @throw Lua::Error Value on top of stack isn't a %Lua function.
+			*/
+			std::string dump(bool strip = false);
+			/**
+			 * @brief Set bytecode cache to be used by `load` (for strings) and loadFile().
+			 *
+			 * With cache set, text chunks are compiled once and then loaded from
+			 * cached bytecode. Same cache may be shared between many States.
+			 *
+			 * @param cache Cache to be used (`nullptr` to disable caching).
+			*/
+			void setBytecodeCache(std::shared_ptr<BytecodeCache> cache) { bytecodeCache = std::move(cache); };
+			/// Get bytecode cache in use (may be `nullptr`).
+			[[nodiscard]] const std::shared_ptr<BytecodeCache>& getBytecodeCache() const noexcept { return bytecodeCache; };
 			/**
 			 * @brief Load default %Lua library.
 			 *
@@ -285,6 +544,33 @@ namespace Lua {
 			 * @param libid ID of lib you need to load.
 			*/
 			void loadDefaultLib(DefaultLibs libid);
+			/**
+			 * @brief Open `coroutine` library (replacement for `luaopen_coroutine`).
+			 *
+			 * `resume` and `wrap` are wrapped to let State know which coroutine is running,
+			 * so interrupt() can reach it. Used by loadDefaultLib(); use it instead of
+			 * `luaopen_coroutine` if you open libraries by hand.
+			*/
+			static int openCoroutineLib(lua_State* L);
+			/**
+			 * @brief Make default %Lua library available, but open it only on first use.
+			 *
+			 * Library global is provided by `__index` metamethod of `_G` and library
+			 * is also added to `package.preload`, so both `math.pi` and `require 'math'`
+			 * open it as usual. Most short-lived States never touch most libraries,
+			 * so they are created faster and use less memory.
+			 *
+			 * `base`, `string` (it sets metatable for strings) and `package` can't be
+			 * deferred and are loaded right away.
+			 *
+			 * @note Load `package` first for `require` to work.
+			 * @note Differences from eager loading are only visible with raw access
+			 * (`rawget`, `next`, `pairs` over `_G`) or if `_G` metatable is replaced.
+			 * Also, library global assigned `nil` comes back on next access.
+			 *
+			 * @param libid ID of lib you need to load.
+			*/
+			void loadDefaultLibLazy(DefaultLibs libid);
 			/// @}
 
 			/// @name Package library control
@@ -303,6 +589,8 @@ namespace Lua {
 			 * 2. `package.searchpath` (capable of scanning filesystem)
 			 * 3. All `package.searchers` except first one (used for `package.preload`)
 			 *
+			 * Use addDirectory() or addArchive() to load %Lua modules from disk safely.
+			 *
 			 * @return Have operation succeeded.
 			 *
 			 * @warning This function assume untouched environment with just loaded `package`
@@ -351,6 +639,54 @@ namespace Lua {
 			*/
 			bool addPreloaded(const std::string& name, const CppFunction& loader);
 			bool addPreloaded(const std::string& name, lua_CFunction loader);
+
+			/**
+			 * @brief Add precompiled (or source) chunk as module loader.
+			 *
+			 * Chunk is not loaded until module is required. Then it's loaded and
+			 * called with usual loader arguments, so it works exactly like `.lua` file
+			 * found by standard searcher.
+			 *
+			 * This is used by code generated with `lua_embedscripts` CMake function.
+			 *
+			 * @warning Chunk data isn't copied and must outlive State.
+			 *
+			 * @param name Key to be used as module name.
+			 * @param chunk Binary or text chunk.
+			 * @param mode Mode to load chunk in. Default is `LoadMode::BINARY`, as this
+			 * function is intended for trusted, built-in data.
+			 *
+			 * @return Was operation successful.
+			*/
+			bool addPreloadedChunk(const std::string& name, std::string_view chunk, LoadMode mode = LoadMode::BINARY);
+
+			/**
+			 * @brief Serve modules from archive with `require`.
+			 *
+			 * Appends native searcher to `package.searchers`. Searcher finds module in
+			 * archive index and loads its chunk straight from mapped memory, no files
+			 * are opened or checked.
+			 *
+			 * @param archive Archive to be used (shared between States is fine).
+			 * @param mode Mode to load chunks in.
+			 *
+			 * @return Was operation successful.
+			*/
+			bool addArchive(std::shared_ptr<const ModuleArchive> archive, LoadMode mode = LoadMode::BOTH);
+
+			/**
+			 * @brief Serve modules from directory tree with `require`.
+			 *
+			 * Appends native searcher to `package.searchers`. Module files are found
+			 * with index of ModuleDirectory, so misses cost no system calls, and loaded
+			 * with loadFile() (bytecode cache is used, if set).
+			 *
+			 * @param dir Directory to be used (shared between States is fine).
+			 * @param mode Mode to load files in.
+			 *
+			 * @return Was operation successful.
+			*/
+			bool addDirectory(std::shared_ptr<ModuleDirectory> dir, LoadMode mode = LoadMode::TEXT);
 			/// @}
 
 			/// @name Warning management
@@ -376,6 +712,145 @@ namespace Lua {
 
 			/// @}
 
+			/// @name Baseline snapshots
+			/// @{
+
+			/**
+			 * @brief Remember current environment as clean baseline.
+			 *
+			 * Shallow copies of globals table and `package.loaded` are saved into registry,
+			 * so resetToBaseline() can later undo changes made by scripts. Call it after
+			 * all initialization (libraries, types, bootstrap code) is done.
+			 *
+			 * Calling it again replaces previous baseline.
+			*/
+			void saveBaseline();
+			/**
+			 * @brief Restore environment saved by saveBaseline().
+			 *
+			 * Following is done:
+			 * 1. Globals added since baseline are removed, changed ones are restored.
+			 * 2. Same is done for `package.loaded`, so modules will be loaded again.
+			 * 3. Stack is cleared.
+			 * 4. Optionally, incremental garbage collector step is run.
+			 *
+			 * @warning Restore is shallow: if script modified contents of some library
+			 * table (e.g. `string.foo = 1`), it isn't undone.
+			 *
+			 * @param gcStep Run single garbage collector step after reset.
+			 * @return Was baseline present.
+			*/
+			bool resetToBaseline(bool gcStep = false);
+
+			/// @}
+
+			/// @name Interruption
+			/// @{
+
+			/**
+			 * @brief Stop running %Lua code from another thread.
+			 *
+			 * Installs hook raising error on next instruction of innermost running thread:
+			 * main one, one entered by StatePtr or coroutine resumed with `coroutine`
+			 * library (even one created before). Threads it was entered from get hook
+			 * once it's left. Outermost pcall() throws Lua::InterruptedError; hook keeps
+			 * raising error until then (pcall() called by bindings only passes error on),
+			 * so script can't ignore it by catching error. If no code is running, next call
+			 * is interrupted (use clearInterrupt() to prevent that). Hooks replaced by
+			 * interruption (CallBudget, profiler) are restored afterwards.
+			 *
+			 * Coroutines resumed by C++ code with plain `lua_resume` are only stopped once
+			 * they yield or return.
+			 *
+			 * @note This function is thread-safe (unlike everything else in State) and
+			 * lock-free: it only sets atomic flag and calls `lua_sethook`, so it may be
+			 * called from signal handler too.
+			 * @see Watchdog to interrupt calls running for too long.
+			*/
+			void interrupt();
+			/**
+			 * @brief Remove pending interruption.
+			 *
+			 * Restores hooks replaced by interrupt(). Must be called from thread using State.
+			 *
+			 * @return Was error already raised by interruption.
+			*/
+			bool clearInterrupt();
+
+			/// @}
+
+			/// @name Profiling
+			/// @{
+
+			/**
+			 * @brief Start sampling profiler.
+			 *
+			 * Installs count hook on main thread and thread currently managed by State
+			 * (coroutines created later inherit it). Threads already having hook set by
+			 * lua++ (pcall() with CallBudget, Scheduler) are sampled by that hook instead.
+			 * Samples are added to ones recorded before (see resetProfiler()).
+			 *
+			 * @param interval Time between samples.
+			 * @param granularity Instructions between clock checks.
+			*/
+			void startProfiler(std::chrono::steady_clock::duration interval = std::chrono::milliseconds(1), int granularity = 1000);
+			/// Stop sampling profiler (samples are kept).
+			void stopProfiler();
+			/// Forget all samples.
+			void resetProfiler() noexcept;
+			/// Get profiler with samples (`nullptr` if it was never started).
+			[[nodiscard]] const Profiler* getProfiler() const noexcept { return profiler.get(); };
+
+			/// @}
+
+			/// @name Binding statistics
+			/// @{
+
+			/**
+			 * @brief Start or stop recording calls of C++ bindings (see CallStats).
+			 *
+			 * When disabled, call overhead is one extra branch. Recorded data is kept.
+			*/
+			void enableCallStats(bool enable = true);
+			/// Forget recorded calls.
+			void resetCallStats() noexcept { if (callStats) callStats->reset(); };
+			/// Get recorded calls (`nullptr` if recording was never enabled).
+			[[nodiscard]] const CallStats* getCallStats() const noexcept { return callStats.get(); };
+			/// Statistics calls should be recorded to (`nullptr` if disabled).
+			[[nodiscard]] CallStats* activeCallStats() noexcept { return callStatsEnabled ? callStats.get() : nullptr; };
+
+			/// @}
+
+			/// @name Memory usage
+			/// @{
+
+			/**
+			 * @brief Get memory usage of State.
+			 *
+			 * Full statistics are available if State owns AccountingAllocator. Otherwise,
+			 * only `current` is set (as reported by `collectgarbage 'count'`).
+			*/
+			[[nodiscard]] MemoryStats memoryStats() const;
+			/**
+			 * @brief Change memory budget of State.
+			 *
+			 * @param limit Byte budget (zero for unlimited).
+			 * @return Does State own AccountingAllocator.
+			*/
+			bool setMemoryLimit(std::size_t limit);
+			/**
+			 * @brief Get garbage collector control.
+			 *
+			 * Example usage:
+			 * ```
+			 * L.gc().generational();
+			 * L.gc().step(std::chrono::milliseconds(2));
+			 * ```
+			*/
+			[[nodiscard]] GarbageCollector gc() const noexcept { return GarbageCollector(mainState); };
+
+			/// @}
+
 			/// @name Type management
 			/// @{
 
@@ -434,8 +909,16 @@ namespace Lua {
 			*/
 			template<typename T>
 			bool isType(int idx) {
-				auto& handler = getTypeHandler(typeid(T));
-				return handler->checkType(state, idx);
+				if constexpr(std::is_same<T, Value>::value) {
+						return true;
+						}
+				else if constexpr(std::is_same<T, Reference>::value) {
+						return !lua_isnone(state, idx);
+						}
+				else {
+						auto& handler = getTypeHandler(typeid(T));
+						return handler->checkType(state, idx);
+						}
 				};
 
 			/**
@@ -448,6 +931,10 @@ namespace Lua {
 			 * to `push`.
 			 * @note If `std::option<...>` is passed, either contained value or `nil`
 			 * will be pushed.
+			 * @note Lua::Value and Lua::Reference are pushed directly, without type handlers.
+			 * @note Rvalues are forwarded to TypeBase::moveValue(), so handlers that
+			 * store objects on heap (`CppFunction`, `std::shared_ptr` from TypeHelper)
+			 * steal them instead of making a copy.
 			 * @warning This call doesn't check for space on Lua stack
 			 * until std::tuple functional is utilized. Use `push`
 			 * to be safe.
@@ -458,25 +945,36 @@ namespace Lua {
 			*/
 
 			template<typename T>
-			int pushOne(const T& data) {
-				if constexpr(is_tuple<T>::value) {
+			int pushOne(T&& data) {
+				using decayed = std::decay_t<T>;
+
+				if constexpr(is_tuple<decayed>::value) {
 						// Unwrap data passes as a tuple
-						auto call = [this](const auto & ... args) {
-							return push(args...);
+						auto call = [this](auto&& ... args) {
+							return push(std::forward<decltype(args)>(args)...);
 							};
-						return std::apply(call, data);
+						return std::apply(call, std::forward<T>(data));
 						}
-				else if constexpr(is_optional<T>::value) {
+				else if constexpr(is_optional<decayed>::value) {
 						if (data) {
-								return pushOne(*data);
+								return pushOne(*std::forward<T>(data));
 								}
 						else {
 								return pushOne(nullptr);
 								}
 						}
+				else if constexpr(std::is_same<decayed, Value>::value or std::is_same<decayed, Reference>::value) {
+						// Bypass type handlers
+						data.push(state);
+						return 1;
+						}
 				else {
-						using decayed = std::decay_t<const T>;
 						auto& handler = getTypeHandler(typeid(decayed));
+
+						if constexpr(std::is_rvalue_reference_v<T&&> and !std::is_const_v<std::remove_reference_t<T>> and !std::is_trivially_copyable_v<decayed>) {
+								if (handler->moveValue(state, std::ref(static_cast<decayed&>(data)))) return 1;
+								}
+
 						handler->pushValue(state, std::ref(static_cast<const decayed&>(data)));
 						return 1;
 						}
@@ -493,11 +991,17 @@ namespace Lua {
 			 * called to choose type fitting value the best way. This will always result in
 			 * `std::optional` containing value even if no value was recivied (if so, `std::any`
 			 * will simply don't hold anything).
+			 * 2. Type is Lua::Value. Value is read directly by Value::fromStack() without
+			 * type handler lookup and `std::any` allocations. Like with `std::any`, result
+			 * is never empty. Strings are not copied, see Value docs.
+			 * 3. Type is Lua::Reference. Registry reference to any value is created. Result is
+			 * empty only if there is no value at given index.
 			 *
 			 * ## Examples
 			 * ```
 			 * auto str  = getOne<std::string>(1);          // Get string from index 1 if possible
 			 * auto any  = getOne<std::any>(1);             // Get best math for value at index 1 (special case 1)
+			 * auto val  = getOne<Lua::Value>(1);           // Same, but cheaper (special case 2)
 			 * ```
 			 *
 			 * @param idx Index on %Lua stack.
@@ -512,6 +1016,14 @@ namespace Lua {
 				if constexpr(std::is_same<T, std::any>::value) {
 						return getGeneric(idx);
 						}
+				else if constexpr(std::is_same<T, Value>::value) {
+						return Value::fromStack(state, idx);
+						}
+				else if constexpr(std::is_same<T, Reference>::value) {
+						if (lua_isnone(state, idx)) return {};
+
+						return Reference(state, idx);
+						}
 				else {
 						auto& handler = getTypeHandler(typeid(T));
 
@@ -528,15 +1040,18 @@ namespace Lua {
 			 * It will try to push all given arguments one-by-one (see original function docs for details).
 			 * Also, `luaL_checkstack` is called to ensure that stack is big enough.
 			 *
+			 * Arguments are perfectly forwarded, so use `std::move` on objects
+			 * you don't need anymore to avoid copying them.
+			 *
 			 * @param value,Fargs Values to be pushed.
 			 * @return Number of values pushed onto stack (eqaul to number of argumnets until
 			 * using tuples)
 			 * @throw Lua::Error Type handler wasn't found.
 			*/
 			template<typename... Targs>
-			int push(Targs... Fargs) {
+			int push(Targs&& ... Fargs) {
 				luaL_checkstack(state, sizeof...(Targs), "failure in `push` C++ call allocation");
-				return (pushOne<Targs>(Fargs) + ...);
+				return (pushOne(std::forward<Targs>(Fargs)) + ...);
 				};
 
 			/**
@@ -597,6 +1112,139 @@ namespace Lua {
 				};
 			/// @}
 
+			/// @name Interned keys
+			/// @{
+
+			/**
+			 * @brief Push interned key string onto %Lua stack.
+			 *
+			 * First call for each key creates string and saves it into registry,
+			 * all futher calls are a single `lua_rawgeti`.
+			 *
+			 * @param key Key to be pushed.
+			*/
+			void pushKey(const Key& key) {
+				auto id = key.getId();
+
+				if (id < keySlots.size() and keySlots[id] != LUA_NOREF) {
+						luaL_checkstack(state, 1, nullptr);
+						lua_rawgeti(state, LUA_REGISTRYINDEX, keySlots[id]);
+						}
+				else {
+						internKey(key);
+						}
+				};
+
+			/**
+			 * @brief Push `t[key]` onto stack, where `t` is table at given index.
+			 *
+			 * This is an analogue of `lua_getfield`, but with interned key.
+			 * @warning Access is raw (`lua_rawget`), so no metamethods are called.
+			 *
+			 * @param idx Index of table on %Lua stack.
+			 * @param key Key to be used.
+			 * @return Type of pushed value.
+			*/
+			int getField(int idx, const Key& key) {
+				idx = lua_absindex(state, idx);
+				pushKey(key);
+				return lua_rawget(state, idx);
+				};
+
+			/**
+			 * @brief Do `t[key] = v`, where `t` is table at given index and `v` is value on top of stack.
+			 *
+			 * This is an analogue of `lua_setfield`, but with interned key. Value is popped.
+			 * @warning Access is raw (`lua_rawset`), so no metamethods are called.
+			 *
+			 * @param idx Index of table on %Lua stack.
+			 * @param key Key to be used.
+			*/
+			void setField(int idx, const Key& key) {
+				idx = lua_absindex(state, idx);
+				pushKey(key);
+				lua_insert(state, -2);
+				lua_rawset(state, idx);
+				};
+
+			/**
+			 * @brief Push global variable onto stack.
+			 *
+			 * Same as getField() on globals table.
+			 * @return Type of pushed value.
+			*/
+			int getGlobal(const Key& key) {
+				luaL_checkstack(state, 1, nullptr);
+				lua_pushglobaltable(state);
+				auto res = getField(-1, key);
+				lua_remove(state, -2);
+				return res;
+				};
+
+			/**
+			 * @brief Pop value from stack and set it as global variable.
+			 *
+			 * Same as setField() on globals table.
+			*/
+			void setGlobal(const Key& key) {
+				luaL_checkstack(state, 1, nullptr);
+				lua_pushglobaltable(state);
+				lua_insert(state, -2);
+				setField(-2, key);
+				pop(1);
+				};
+
+			/**
+			 * @brief Push value located by path from table at given index.
+			 *
+			 * Each path segment is looked up with getField(). If some intermediate value
+			 * isn't a table, `nil` is pushed.
+			 * @warning Access is raw, so no metamethods are called.
+			 *
+			 * @param idx Index of root table on %Lua stack.
+			 * @param path Precompiled path.
+			 * @return Type of pushed value (`LUA_TNIL` if lookup failed).
+			*/
+			int pushPath(int idx, const Path& path);
+
+			/**
+			 * @brief Get value located by path from table at given index.
+			 *
+			 * Stack is left unchanged.
+			 * @note Lua::Value results are made owning, as string may be collected after return.
+			 *
+			 * @param idx Index of root table on %Lua stack.
+			 * @param path Precompiled path.
+			 * @return Same as getOne(): empty `std::optional` if value is missing or has
+			 * different type. Misses never throw.
+			 * @throw Lua::Error Type handler wasn't found.
+			*/
+			template<typename T>
+			std::optional<T> getPath(int idx, const Path& path) {
+				pushPath(idx, path);
+				auto res = getOne<T>(-1);
+
+				if constexpr(std::is_same<T, Value>::value) {
+						res->makeOwned();
+						}
+
+				pop(1);
+				return res;
+				};
+
+			/**
+			 * @brief Get value located by path from referenced table.
+			 * @copydetails getPath(int, const Path&)
+			*/
+			template<typename T>
+			std::optional<T> getPath(const Reference& root, const Path& path) {
+				root.push(state);
+				auto res = getPath<T>(-1, path);
+				pop(1);
+				return res;
+				};
+			/// @}
+
 			/// Get underlying `lua_State*`
 			operator lua_State* () { return state; };
 		};
@@ -614,6 +1262,7 @@ namespace Lua {
 		private:
 			State* ptr = nullptr; ///< Pointer to State used for current lua_State
 			lua_State* oldState = nullptr; ///< lua_State that was managed before this call (`nullptr` if not changed)
+			State::RunningThread running; ///< Entry of thread if it wasn't running already (see State::enterThread())
 
 		public:
 			StatePtr() = delete;
@@ -0,0 +1,123 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <limits>
+#include "lua++/State.hpp"
+
+/**
+ * @file lua++/StatePool.hpp
+ * @brief Pool of pre-initialized states
+*/
+
+namespace Lua {
+	/**
+	 * @brief Pool of pre-initialized State objects.
+	 *
+	 * Creating State with all libraries and types is expensive, while sharing
+	 * one between unrelated jobs leaks globals between them. Pool solves this
+	 * by keeping idle states around and resetting them to baseline (see
+	 * State::saveBaseline() and State::resetToBaseline()) when they are returned.
+	 *
+	 * ```
+	 * Lua::StatePool pool([] {
+	 *     auto L = std::make_unique<Lua::State>();
+	 *     L->registerType(std::make_shared<MyTypeHandler>());
+	 *     return L;
+	 * }, 4);
+	 *
+	 * {
+	 *     auto L = pool.acquire();
+	 *     L->load(script);
+	 *     L->pcall(0, 0);
+	 * } // State is reset and returned to pool here
+	 * ```
+	 *
+	 * @note All members are thread-safe. Acquired State itself is not.
+	*/
+	class StatePool {
+		public:
+			/// Function to create new fully initialized State.
+			using Factory = std::function<std::unique_ptr<State>()>;
+
+			/// Pool usage counters.
+			struct Stats {
+				std::size_t idle = 0;       ///< States waiting in pool.
+				std::size_t inUse = 0;      ///< States currently acquired.
+				std::size_t highWater = 0;  ///< Maximum of `inUse` ever observed.
+				std::size_t created = 0;    ///< States created by factory in total.
+				std::size_t destroyed = 0;  ///< States dropped because pool was full.
+				std::size_t acquired = 0;   ///< Number of acquire() calls.
+				std::size_t reused = 0;     ///< acquire() calls served by idle State.
+				};
+
+			/**
+			 * @brief RAII handle for acquired State.
+			 *
+			 * Returns State to pool on destruction.
+			 * @warning Handle must not outlive pool.
+			*/
+			class Handle {
+					friend class StatePool;
+				private:
+					StatePool* pool = nullptr;  ///< Pool to return State into.
+					std::unique_ptr<State> ptr; ///< Acquired State.
+
+					Handle(StatePool* p, std::unique_ptr<State> L): pool(p), ptr(std::move(L)) {}; ///< Used by pool.
+				public:
+					Handle(Handle&& old) noexcept = default; ///< Move constructor.
+					Handle& operator=(Handle&& old) noexcept; ///< Return own State and take other one.
+					Handle(const Handle&) = delete; ///< Explicitly deleted to prevent copy.
+					Handle& operator=(const Handle&) = delete; ///< Explicitly deleted to prevent copy.
+					~Handle(); ///< Return State to pool.
+
+					/// Return State to pool before handle is destroyed.
+					void release();
+
+					State& operator*() { return *ptr; };  ///< Access State
+					State* operator->() { return ptr.get(); }; ///< Access State
+					State* get() { return ptr.get(); };    ///< Access State
+				};
+
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param factory Function to create new States. State created by it will
+			 * have baseline saved right after creation.
+			 * @param prewarm Number of States to create right away.
+			 * @param maxIdle Maximum number of idle States kept. Extra ones are destroyed on return.
+			 * @param gcOnRelease Run garbage collector step when State is returned.
+			*/
+			explicit StatePool(Factory factory = defaultFactory, std::size_t prewarm = 0,
+							   std::size_t maxIdle = std::numeric_limits<std::size_t>::max(), bool gcOnRelease = false);
+			StatePool(const StatePool&) = delete; ///< Explicitly deleted to prevent copy.
+			StatePool& operator=(const StatePool&) = delete; ///< Explicitly deleted to prevent copy.
+
+			/**
+			 * @brief Get State from pool (or create new one if pool is empty).
+			 * @throw Anything factory throws.
+			*/
+			Handle acquire();
+			/// Create States until there are at least `count` idle ones.
+			void prewarm(std::size_t count);
+			/// Drop all idle States.
+			void clear();
+			/// Get usage counters.
+			[[nodiscard]] Stats getStats() const;
+
+			/// Factory creating `Lua::State()` with default arguments.
+			static std::unique_ptr<State> defaultFactory() { return std::make_unique<State>(); };
+		private:
+			Factory factory;                           ///< Function used to create States.
+			std::size_t maxIdle;                       ///< Maximum number of idle States.
+			bool gcOnRelease;                          ///< Run GC step on return.
+			mutable std::mutex mutex;                  ///< Protects fields below.
+			std::vector<std::unique_ptr<State>> idle;  ///< Idle States.
+			Stats stats;                               ///< Usage counters (`idle` is computed on request).
+
+			std::unique_ptr<State> create();           ///< Create State and save its baseline.
+			void release(std::unique_ptr<State> L);    ///< Reset State and put it back.
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
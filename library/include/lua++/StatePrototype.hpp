@@ -0,0 +1,117 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include "lua++/State.hpp"
+
+/**
+ * @file lua++/StatePrototype.hpp
+ * @brief Compact description of State configuration for fast instantiation
+*/
+
+namespace Lua {
+	/**
+	 * @brief Recorded State configuration.
+	 *
+	 * %Lua has no way to copy `lua_State`, so instead of cloning State prototype
+	 * records what has to be done to get identical one and replays it:
+	 *
+	 * 1. Library preset and extra libraries.
+	 * 2. Type handlers (same handler objects are reused, only their `init` is run).
+	 * 3. `package.preload` entries.
+	 * 4. Bootstrap scripts, which are compiled once into bytecode when added.
+	 *
+	 * ```
+	 * Lua::StatePrototype proto(Lua::DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE);
+	 * proto.addType(std::make_shared<Lua::TypeHelper<MyClass>>())
+	 *      .addPreloaded("lpeg", luaopen_lpeg)
+	 *      .addBootstrap(bootstrapCode, "=bootstrap");
+	 *
+	 * auto L = proto.instantiate();
+	 * Lua::StatePool pool([&proto] { return proto.instantiate(); });
+	 * ```
+	 *
+	 * @note instantiate() is `const` and may be called from many threads at once.
+	 * Prototype must not be modified meanwhile.
+	*/
+	class StatePrototype {
+		private:
+			/// `package.preload` entry.
+			struct Preload {
+				std::string name;                               ///< Module name.
+				std::variant<lua_CFunction, CppFunction> loader; ///< Loader function.
+				};
+
+			/// Precompiled bootstrap script.
+			struct Bootstrap {
+				std::string name;     ///< Chunk name (for error messages).
+				std::string bytecode; ///< Result of State::dump().
+				};
+
+			DefaultLibsPreset preset;                    ///< Preset passed to State constructor.
+			std::vector<DefaultLibs> libs;               ///< Extra libraries.
+			std::vector<std::shared_ptr<TypeBase>> types; ///< Type handlers.
+			std::vector<Preload> preloads;               ///< `package.preload` entries.
+			std::vector<Bootstrap> scripts;              ///< Bootstrap scripts.
+			bool stripDebug = false;                     ///< Strip debug info from bootstrap bytecode.
+			bool lazyLibs = false;                       ///< Open libraries on first access.
+
+			void replay(State& L) const;                 ///< Apply everything except preset to State.
+		public:
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param openlibs Preset to be passed to State constructor.
+			 * @param strip Strip debug information from bootstrap bytecode (smaller, but
+			 * error messages lose line numbers).
+			*/
+			explicit StatePrototype(DefaultLibsPreset openlibs = DefaultLibsPreset::SAFE_WITH_PACKAGE, bool strip = false):
+				preset(openlibs),
+				stripDebug(strip) {};
+
+			/// Open libraries on first access (see State::loadDefaultLibLazy()).
+			StatePrototype& setLazyLibs(bool lazy = true) { lazyLibs = lazy; return *this; };
+			/// Load additional default library (see State::loadDefaultLib()).
+			StatePrototype& addLib(DefaultLibs libid);
+			/// Register type handler (see State::registerType()).
+			StatePrototype& addType(const std::shared_ptr<TypeBase>& ptr);
+			/// Add `package.preload` entry (see State::addPreloaded()).
+			StatePrototype& addPreloaded(const std::string& name, const CppFunction& loader);
+			/// Add `package.preload` entry (see State::addPreloaded()).
+			StatePrototype& addPreloaded(const std::string& name, lua_CFunction loader);
+			/**
+			 * @brief Add script to be run in every new State.
+			 *
+			 * Script is compiled right away, so syntax errors are reported here.
+			 * Scripts are run in order they were added, after everything else is set up.
+			 *
+			 * @param code %Lua source code.
+			 * @param name Chunk name (use `=name` or `@file` forms as in %Lua).
+			 *
+			 * @throw Lua::SyntaxError Script failed to compile.
+			*/
+			StatePrototype& addBootstrap(std::string_view code, const std::string& name = "=bootstrap");
+
+			/**
+			 * @brief Create new State from prototype.
+			 *
+			 * @param alloc,ud Passed to State constructor.
+			 * @return Fully initialized State.
+			 * @throw Lua::StateError Bootstrap script failed.
+			 * @throw std::bad_alloc Out of memory.
+			*/
+			std::unique_ptr<State> instantiate(lua_Alloc alloc = nullptr, void* ud = nullptr) const;
+			/**
+			 * @brief Create new State from prototype with its own allocator.
+			 *
+			 * @param alloc Allocator to be owned by State.
+			 * @return Fully initialized State.
+			 * @throw Lua::StateError Bootstrap script failed.
+			 * @throw std::bad_alloc Out of memory.
+			*/
+			std::unique_ptr<State> instantiate(std::unique_ptr<Allocator> alloc) const;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,290 @@
+#pragma once
+#include <iterator>
+#include <utility>
+#include "lua++/State.hpp"
+
+/**
+ * @file lua++/TableView.hpp
+ * @brief Range-based iteration over %Lua tables
+*/
+
+namespace Lua {
+	/**
+	 * @brief Read values of one type from %Lua stack with handler lookup done once.
+	 *
+	 * Behaves exactly like State::getOne(), but resolves type handler on construction
+	 * and decodes common types (`bool`, Lua::Number, `std::string`, Lua::Value, Lua::Reference)
+	 * directly, without `std::any`.
+	 *
+	 * Additionally, `std::string_view` is supported. It only accepts real strings
+	 * and points into %Lua memory, so it is valid as long as string is referenced from
+	 * %Lua side (e.g. stays in table you're iterating).
+	 *
+	 * @throw Lua::Error Type handler wasn't found (on construction).
+	*/
+	template<typename T>
+	class StackDecoder {
+		private:
+			static constexpr bool isBuiltin =
+				std::is_same<T, bool>::value or
+				std::is_same<T, Number>::value or
+				std::is_same<T, std::string>::value or
+				std::is_same<T, std::string_view>::value or
+				std::is_same<T, Value>::value or
+				std::is_same<T, Reference>::value;
+
+			const TypeBase* handler = nullptr; ///< Cached handler for non-builtin types.
+		public:
+			/// Main constructor
+			explicit StackDecoder([[maybe_unused]] State& L) {
+				if constexpr(!isBuiltin and !std::is_same<T, std::any>::value) {
+						handler = L.getTypeHandler(typeid(T)).get();
+						}
+				};
+
+			/**
+			 * @brief Decode value at given index.
+			 *
+			 * Stack is left unchanged (values are never converted in place, so it's
+			 * safe to use it on keys during `lua_next` traversal).
+			*/
+			std::optional<T> operator()(lua_State* Ls, int idx) const {
+				if constexpr(std::is_same<T, bool>::value) {
+						if (!lua_isboolean(Ls, idx)) return {};
+
+						return static_cast<bool>(lua_toboolean(Ls, idx));
+						}
+				else if constexpr(std::is_same<T, Number>::value) {
+						if (lua_isinteger(Ls, idx)) return Number(lua_tointeger(Ls, idx));
+
+						int isnum = 0;
+						auto num = lua_tonumberx(Ls, idx, &isnum);
+
+						if (!isnum) return {};
+
+						return Number(num);
+						}
+				else if constexpr(std::is_same<T, std::string_view>::value or std::is_same<T, std::string>::value) {
+						std::size_t len = 0;
+
+						if (lua_type(Ls, idx) == LUA_TSTRING) {
+								const char* data = lua_tolstring(Ls, idx, &len);
+								return T(data, len);
+								}
+
+						if constexpr(std::is_same<T, std::string>::value) {
+								if (lua_type(Ls, idx) == LUA_TNUMBER) {
+										// Convert copy to keep original untouched
+										luaL_checkstack(Ls, 1, nullptr);
+										lua_pushvalue(Ls, idx);
+										const char* data = lua_tolstring(Ls, -1, &len);
+										T res(data, len);
+										lua_pop(Ls, 1);
+										return res;
+										}
+								}
+
+						return {};
+						}
+				else if constexpr(std::is_same<T, Value>::value) {
+						return Value::fromStack(Ls, idx);
+						}
+				else if constexpr(std::is_same<T, Reference>::value) {
+						if (lua_isnone(Ls, idx)) return {};
+
+						return Reference(Ls, idx);
+						}
+				else if constexpr(std::is_same<T, std::any>::value) {
+						StatePtr Lp(Ls);
+						return Lp->getOne<std::any>(idx);
+						}
+				else {
+						if (!handler->checkType(Ls, idx)) return {};
+
+						return std::any_cast<T>(handler->getValue(Ls, idx));
+						}
+				};
+		};
+
+	/**
+	 * @brief Range over array part of table (`t[1]` … `t[#t]`).
+	 *
+	 * Length is computed once with `lua_rawlen`, elements are read with `lua_rawgeti`.
+	 * Stack is unchanged between iterations. Returned by TableView::array().
+	*/
+	template<typename T>
+	class ArrayRange {
+		private:
+			lua_State* Ls;            ///< %Lua thread to work in.
+			int idx;                  ///< Absolute index of table.
+			lua_Integer len;          ///< Table length.
+			StackDecoder<T> decoder;  ///< Decoder for values.
+		public:
+			/// Iterator over array elements.
+			class iterator {
+				private:
+					const ArrayRange* range; ///< Range being iterated.
+					lua_Integer i;           ///< Current index in table.
+				public:
+					using iterator_category = std::input_iterator_tag;
+					using value_type = std::optional<T>;
+					using difference_type = std::ptrdiff_t;
+					using pointer = void;
+					using reference = value_type;
+
+					iterator(const ArrayRange* r, lua_Integer pos): range(r), i(pos) {}; ///< Main constructor
+					/// Read current element (empty if it can't be represented as `T`).
+					value_type operator*() const {
+						lua_rawgeti(range->Ls, range->idx, i);
+						auto res = range->decoder(range->Ls, -1);
+						lua_pop(range->Ls, 1);
+						return res;
+						};
+					iterator& operator++() { ++i; return *this; }; ///< Advance to next element
+					bool operator==(const iterator& other) const { return i == other.i; }; ///< Compare positions
+					bool operator!=(const iterator& other) const { return i != other.i; }; ///< Compare positions
+					/// Index of current element in table.
+					[[nodiscard]] lua_Integer index() const noexcept { return i; };
+				};
+
+			/// Main constructor (prefer TableView::array()).
+			ArrayRange(State& L, int tidx):
+				Ls(L),
+				idx(lua_absindex(L, tidx)),
+				len(static_cast<lua_Integer>(lua_rawlen(L, idx))),
+				decoder(L) {
+				luaL_checkstack(Ls, 2, nullptr);
+				};
+
+			iterator begin() const { return iterator(this, 1); };       ///< Iterator to first element
+			iterator end() const { return iterator(this, len + 1); };   ///< Past-the-end iterator
+			/// Number of elements.
+			[[nodiscard]] lua_Integer size() const noexcept { return len; };
+		};
+
+	/**
+	 * @brief Range over all key-value pairs of table (like `pairs` without `__pairs`).
+	 *
+	 * Traversal is done with `lua_next`, so current key and value stay on top of stack while
+	 * loop body runs. Stack top is restored when range is destroyed, even if loop was left
+	 * early with `break`, `return` or exception. Returned by TableView::pairs().
+	 *
+	 * @warning Don't modify table (except assigning to existing fields) during traversal, and
+	 * don't pop values pushed by iteration.
+	*/
+	template<typename K, typename V>
+	class PairsRange {
+		private:
+			lua_State* Ls;              ///< %Lua thread to work in.
+			int idx;                    ///< Absolute index of table.
+			int top;                    ///< Stack top before iteration.
+			StackDecoder<K> kdecoder;   ///< Decoder for keys.
+			StackDecoder<V> vdecoder;   ///< Decoder for values.
+		public:
+			/// Iterator over table pairs.
+			class iterator {
+				private:
+					const PairsRange* range; ///< Range being iterated.
+					bool done;               ///< Was end reached.
+				public:
+					using iterator_category = std::input_iterator_tag;
+					using value_type = std::pair<std::optional<K>, std::optional<V>>;
+					using difference_type = std::ptrdiff_t;
+					using pointer = void;
+					using reference = value_type;
+
+					iterator(const PairsRange* r, bool end): range(r), done(end) {}; ///< Main constructor
+					/// Read current pair (each part is empty if it can't be represented as requested type).
+					value_type operator*() const {
+						return {range->kdecoder(range->Ls, -2), range->vdecoder(range->Ls, -1)};
+						};
+					/// Advance to next pair.
+					iterator& operator++() {
+						// Stack: xxx, key, value
+						lua_pop(range->Ls, 1);
+
+						// Stack: xxx, key
+						if (!lua_next(range->Ls, range->idx)) {
+								// Stack: xxx
+								done = true;
+								}
+
+						return *this;
+						};
+					bool operator==(const iterator& other) const { return done == other.done; }; ///< Compare positions
+					bool operator!=(const iterator& other) const { return done != other.done; }; ///< Compare positions
+				};
+
+			/// Main constructor (prefer TableView::pairs()).
+			PairsRange(State& L, int tidx):
+				Ls(L),
+				idx(lua_absindex(L, tidx)),
+				top(lua_gettop(L)),
+				kdecoder(L),
+				vdecoder(L) {};
+			PairsRange(const PairsRange&) = delete; ///< Explicitly deleted: range owns stack slots.
+			PairsRange& operator=(const PairsRange&) = delete; ///< Explicitly deleted: range owns stack slots.
+			~PairsRange() { lua_settop(Ls, top); }; ///< Restore stack top.
+
+			/// Start traversal.
+			iterator begin() const {
+				lua_settop(Ls, top);
+				luaL_checkstack(Ls, 3, nullptr);
+				lua_pushnil(Ls);
+				// Stack: xxx, nil
+				return iterator(this, !lua_next(Ls, idx));
+				};
+			iterator end() const { return iterator(this, true); }; ///< Past-the-end iterator
+		};
+
+	/**
+	 * @brief View of %Lua table located on stack.
+	 *
+	 * Example:
+	 * ```
+	 * Lua::TableView view(L, -1);
+	 *
+	 * for (auto num : view.array<Lua::Number>()) {
+	 *     sum += (lua_Number)num.value_or(0_ln);
+	 * }
+	 *
+	 * for (auto [key, value] : view.pairs<std::string_view, Lua::Value>()) {
+	 *     …
+	 * }
+	 * ```
+	 *
+	 * @warning Table must stay on its stack position while view (and ranges created from it) is used.
+	 * @note Access is raw, so no metamethods are called.
+	*/
+	class TableView {
+		private:
+			State& L; ///< State table belongs to.
+			int idx;  ///< Absolute index of table.
+		public:
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param Ls State to work in.
+			 * @param tidx Index of table on %Lua stack.
+			*/
+			TableView(State& Ls, int tidx): L(Ls), idx(lua_absindex(Ls, tidx)) {};
+
+			/// Raw length of table (`#t` without `__len`).
+			[[nodiscard]] lua_Integer length() const { return static_cast<lua_Integer>(lua_rawlen(L, idx)); };
+
+			/**
+			 * @brief Iterate over array part of table.
+			 * @throw Lua::Error Type handler wasn't found.
+			*/
+			template<typename T>
+			ArrayRange<T> array() const { return ArrayRange<T>(L, idx); };
+
+			/**
+			 * @brief Iterate over all pairs of table.
+			 * @throw Lua::Error Type handler wasn't found.
+			*/
+			template<typename K, typename V>
+			PairsRange<K, V> pairs() const { return PairsRange<K, V>(L, idx); };
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
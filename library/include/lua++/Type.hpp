@@ -85,6 +85,19 @@ namespace Lua {
 			 * If you get `std::bad_any_cast`, try to check type of passed object with `obj.type().name()`.
 			*/
 			virtual void pushValue(lua_State* L, const std::any& obj) const = 0;
+			/**
+			 * @brief Push C++ object onto %Lua stack, taking ownership of it.
+			 *
+			 * Called by State::pushOne() for rvalues of non-trivially copyable types.
+			 * Override it if your handler stores objects on heap (like TypeCppFunction
+			 * or TypeHelper do) and can steal contents instead of copying them.
+			 *
+			 * @param L %Lua state you're working with
+			 * @param obj `std::any` with `std::reference_wrapper<T>` (where `T` is type handled by you).
+			 * You may leave object in moved-from state.
+			 * @return Was value pushed. If `false` (default), State will call `pushValue` instead.
+			*/
+			virtual bool moveValue([[maybe_unused]] lua_State* L, [[maybe_unused]] const std::any& obj) const { return false; };
 
 			TypeBase() = default;
 			virtual ~TypeBase() = default;
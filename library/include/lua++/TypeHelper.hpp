@@ -25,8 +25,7 @@ namespace Lua {
 
 	template<typename T>
 	int staticGetConstructor(StatePtr& Lp) {
-		auto obj = std::make_shared<T>(Lp);
-		Lp->push(obj);
+		Lp->push(std::make_shared<T>(Lp));
 		return 1;
 		};
 
@@ -144,7 +143,21 @@ namespace Lua {
 						if (name and T::methods.count(*name)) {
 								// Create functional object with our method (object itself isn't included)
 								CppFunction func = std::bind(callMethod, std::placeholders::_1, T::methods.at(*name));
-								Lp->push(func);
+								Lp->push(std::move(func));
+
+								if (Lp->activeCallStats()) {
+										// `Type:method` names are built only once
+										static const auto statNames = [] {
+											std::unordered_map<std::string, std::string> res;
+											const auto typeName = CallStats::typeName(typeid(T));
+
+											for (const auto& entry : T::methods) res.emplace(entry.first, typeName + ":" + entry.first);
+
+											return res;
+											}();
+										TypeCppFunction::setName(L, -1, statNames.at(*name));
+										}
+
 								return 1;
 								};
 						}
@@ -186,9 +199,11 @@ namespace Lua {
 			 * @return Was state pushed onto stack.
 			*/
 			bool pushStatic(StatePtr& Lp) const {
+				static const Key staticKey("static");
+
 				if (luaL_getmetatable(**Lp, tname().c_str()) != LUA_TNIL) {
 						// Type is registered
-						if (lua_getfield(**Lp, -1, "static") != LUA_TNIL) {
+						if (Lp->getField(-1, staticKey) != LUA_TNIL) {
 								// Table exsist, remove mt from stack
 								lua_remove(**Lp, -2);
 								return true;
@@ -288,6 +303,17 @@ namespace Lua {
 				// And only THEN add real data
 				*newptr = new ptrT(origPtr);
 				};
+
+			bool moveValue(lua_State* L, const std::any& obj) const override {
+				using ptrT = std::shared_ptr<T>;
+				auto& origPtr = std::any_cast<std::reference_wrapper<ptrT>>(obj).get();
+				auto newptr = static_cast<ptrT**>(lua_newuserdatauv(L, sizeof(ptrT*), 0));
+				*newptr = nullptr;
+				luaL_setmetatable(L, tname().c_str());
+				// Steal reference instead of bumping refcount
+				*newptr = new ptrT(std::move(origPtr));
+				return true;
+				};
 		};
 	};
 // kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4; 
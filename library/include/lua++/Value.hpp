@@ -0,0 +1,131 @@
+#pragma once
+#include <variant>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <type_traits>
+#include "lua.hpp"
+#include "lua++/Number.hpp"
+#include "lua++/Reference.hpp"
+
+/**
+ * @file lua++/Value.hpp
+ * @brief Lightweight dynamically typed %Lua value
+*/
+
+namespace Lua {
+	/**
+	 * @brief Dynamically typed %Lua value.
+	 *
+	 * This is a lightweight alternative to `std::any` for cases when you
+	 * don't know type of value in advance (logging, generic containers, etc.).
+	 * It never goes through type handlers and doesn't allocate unless it has to
+	 * own a long string or create a registry reference.
+	 *
+	 * | %Lua type                           | Stored as                                |
+	 * |-------------------------------------|------------------------------------------|
+	 * | `nil`                               | `std::nullptr_t`                         |
+	 * | `boolean`                           | `bool`                                   |
+	 * | `number` (integer)                  | `lua_Integer`                            |
+	 * | `number` (float)                    | `lua_Number`                             |
+	 * | `string`                            | `std::string_view` or `std::string`      |
+	 * | `light userdata`                    | `void*`                                  |
+	 * | `table`, `function`, `userdata`, `thread` | Lua::Reference                     |
+	 *
+	 * Can be used with State::push, State::get and CppFunctionNative directly:
+	 * ```
+	 * Lua::CppFunctionNative<Lua::Value>([](const Lua::Value& v) { log(v.toString()); });
+	 * ```
+	 *
+	 * @warning Strings recivied from %Lua stack are stored as `std::string_view` pointing
+	 * to %Lua memory, which is only valid while value is on stack. Call makeOwned()
+	 * before storing such value for later usage.
+	*/
+	class Value {
+		public:
+			/// Internal holder type.
+			using Holder = std::variant<std::nullptr_t, bool, lua_Integer, lua_Number, std::string_view, std::string, void*, Reference>;
+		private:
+			Holder holder; ///< Actual value.
+		public:
+			Value() noexcept: holder(nullptr) {}; ///< Construct `nil`.
+			Value(std::nullptr_t) noexcept: holder(nullptr) {}; ///< Construct `nil`.
+			explicit Value(bool b) noexcept: holder(b) {}; ///< Construct boolean.
+			/// Construct integer (from any integral type, so `Value(1)` isn't ambiguous).
+			template<typename T, std::enable_if_t<std::is_integral_v<T> and !std::is_same_v<T, bool>, int> = 0>
+			explicit Value(T num) noexcept: holder(static_cast<lua_Integer>(num)) {};
+			explicit Value(lua_Number num) noexcept: holder(num) {}; ///< Construct float.
+			/// Construct number, preserving integer/float distinction.
+			Value(const Number& num) noexcept: holder(std::nullptr_t()) {
+				if (num.isInteger()) holder = static_cast<lua_Integer>(num);
+				else                 holder = static_cast<lua_Number>(num);
+				};
+			/// Construct non-owning string. Make sure it outlives Value or call makeOwned().
+			explicit Value(std::string_view str) noexcept: holder(str) {};
+			/// Construct owning string.
+			Value(std::string str) noexcept: holder(std::move(str)) {};
+			/// Construct owning string.
+			Value(const char* str): holder(std::string(str)) {};
+			/// Construct light userdata.
+			explicit Value(void* ptr) noexcept: holder(ptr) {};
+			/// Construct from registry reference.
+			Value(Reference ref) noexcept: holder(std::move(ref)) {};
+
+			/**
+			 * @brief Read value from %Lua stack.
+			 *
+			 * @param L %Lua state you're working with
+			 * @param idx Index of value on %Lua stack (none is treated as `nil`)
+			 * @param own Copy strings instead of referencing %Lua memory.
+			*/
+			static Value fromStack(lua_State* L, int idx, bool own = false);
+			/**
+			 * @brief Push value onto %Lua stack.
+			 *
+			 * @param L %Lua state you're working with
+			*/
+			void push(lua_State* L) const;
+
+			/// @name Type checks
+			/// @{
+			[[nodiscard]] bool isNil() const noexcept { return std::holds_alternative<std::nullptr_t>(holder); };
+			[[nodiscard]] bool isBoolean() const noexcept { return std::holds_alternative<bool>(holder); };
+			[[nodiscard]] bool isInteger() const noexcept { return std::holds_alternative<lua_Integer>(holder); };
+			[[nodiscard]] bool isFloat() const noexcept { return std::holds_alternative<lua_Number>(holder); };
+			[[nodiscard]] bool isNumber() const noexcept { return isInteger() or isFloat(); };
+			[[nodiscard]] bool isString() const noexcept { return std::holds_alternative<std::string_view>(holder) or std::holds_alternative<std::string>(holder); };
+			[[nodiscard]] bool isLightUserdata() const noexcept { return std::holds_alternative<void*>(holder); };
+			[[nodiscard]] bool isReference() const noexcept { return std::holds_alternative<Reference>(holder); };
+			/// Is string value pointing to foreign memory.
+			[[nodiscard]] bool isView() const noexcept { return std::holds_alternative<std::string_view>(holder); };
+			/// %Lua type of value (`LUA_TNIL`, `LUA_TBOOLEAN`, …). References report type of referenced value (see Reference::getType()).
+			[[nodiscard]] int getLuaType() const noexcept;
+			/// @}
+
+			/// @name Accessors
+			/// @{
+			[[nodiscard]] std::optional<bool> getBoolean() const noexcept;
+			[[nodiscard]] std::optional<Number> getNumber() const noexcept;
+			/// Get string (either owned or not). Resulting view is valid while Value is alive and unchanged.
+			[[nodiscard]] std::optional<std::string_view> getString() const noexcept;
+			[[nodiscard]] std::optional<void*> getLightUserdata() const noexcept;
+			[[nodiscard]] const Reference* getReference() const noexcept { return std::get_if<Reference>(&holder); };
+			/// %Lua truthiness: everything but `nil` and `false` is true.
+			[[nodiscard]] bool toBoolean() const noexcept;
+			/**
+			 * @brief Get internal holder.
+			 * @warning This function is not supposed to be used widely.
+			*/
+			[[nodiscard]] const Holder& getInternal() const noexcept { return holder; };
+			/// @}
+
+			/**
+			 * @brief Turn non-owning string into owning one.
+			 *
+			 * No-op for other types.
+			 * @return `*this`
+			*/
+			Value& makeOwned();
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
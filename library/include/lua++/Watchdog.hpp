@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include "lua++/State.hpp"
+
+/**
+ * @file lua++/Watchdog.hpp
+ * @brief Deadline enforcement for State
+*/
+
+namespace Lua {
+	/**
+	 * @brief Thread interrupting State once deadline passes.
+	 *
+	 * Unlike CallBudget, no clock is checked by %Lua code itself: watchdog thread
+	 * sleeps until deadline and calls State::interrupt() if call is still running.
+	 *
+	 * ```
+	 * Lua::Watchdog watchdog(L);
+	 * …
+	 * {
+	 *     auto scope = watchdog.arm(std::chrono::milliseconds(100));
+	 *     L.pcall(0, 0); // Throws Lua::InterruptedError after 100 ms
+	 * }
+	 * ```
+	 *
+	 * @warning Watchdog must not outlive State.
+	*/
+	class Watchdog {
+		public:
+			/**
+			 * @brief RAII handle for armed deadline.
+			 *
+			 * Disarms deadline on destruction. If deadline passed after call has
+			 * returned, pending interruption is removed as well.
+			*/
+			class Scope {
+					friend class Watchdog;
+				private:
+					Watchdog* dog = nullptr; ///< Watchdog which issued this scope.
+					std::uint64_t id = 0;    ///< Number of arming.
+
+					Scope(Watchdog* w, std::uint64_t n): dog(w), id(n) {}; ///< Used by watchdog.
+				public:
+					Scope(Scope&& old) noexcept: dog(old.dog), id(old.id) { old.dog = nullptr; }; ///< Move constructor.
+					Scope& operator=(Scope&&) = delete; ///< Explicitly deleted to keep arming order.
+					Scope(const Scope&) = delete; ///< Explicitly deleted to prevent copy.
+					Scope& operator=(const Scope&) = delete; ///< Explicitly deleted to prevent copy.
+					~Scope(); ///< Disarm deadline.
+
+					/// Has deadline passed (and State was interrupted).
+					[[nodiscard]] bool expired() const;
+				};
+
+			/**
+			 * @brief Main constructor.
+			 *
+			 * @param L State to be watched.
+			*/
+			explicit Watchdog(State& L);
+			Watchdog(const Watchdog&) = delete; ///< Explicitly deleted to prevent copy.
+			Watchdog& operator=(const Watchdog&) = delete; ///< Explicitly deleted to prevent copy.
+			~Watchdog(); ///< Stop thread.
+
+			/**
+			 * @brief Set deadline.
+			 *
+			 * Only one deadline is active at time: arming replaces previous one.
+			 *
+			 * @param deadline Point in time when State will be interrupted.
+			 * @return Scope which disarms deadline when destroyed.
+			*/
+			[[nodiscard]] Scope arm(std::chrono::steady_clock::time_point deadline);
+			/// Set deadline `timeout` from now.
+			[[nodiscard]] Scope arm(std::chrono::steady_clock::duration timeout) {
+				return arm(std::chrono::steady_clock::now() + timeout);
+				};
+		private:
+			State& L;                                                       ///< Watched State.
+			mutable std::mutex mutex;                                       ///< Protects fields below.
+			std::condition_variable cv;                                     ///< Wakes thread on changes.
+			std::optional<std::chrono::steady_clock::time_point> deadline;  ///< Active deadline.
+			std::uint64_t generation = 0;                                   ///< Number of last arming.
+			std::uint64_t fired = 0;                                        ///< Number of last arming which expired.
+			bool stopping = false;                                          ///< Thread must exit.
+			std::thread thread;                                             ///< Thread waiting for deadlines.
+
+			void disarm(std::uint64_t id); ///< Used by Scope.
+			void loop();                   ///< Body of thread.
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "lua++/Allocator.hpp"
+
+namespace Lua {
+	/// Slab header, placed at start of slab.
+	struct PoolAllocator::Slab {
+		Slab* prev = nullptr;     ///< Previous slab in partial list.
+		Slab* next = nullptr;     ///< Next slab in partial list.
+		void* freeList = nullptr; ///< Freed blocks (each holds pointer to next one).
+		char* bump;               ///< First never used block.
+		char* end;                ///< End of last block.
+		std::size_t used = 0;     ///< Number of allocated blocks.
+		std::size_t cls;          ///< Size class of blocks.
+		};
+
+	AccountingAllocator::AccountingAllocator(std::size_t limit, std::unique_ptr<Allocator> innerAlloc):
+		inner(std::move(innerAlloc)) {
+		stats.limit = limit;
+		};
+
+	void* AccountingAllocator::reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept {
+		// osize is object type for new blocks
+		std::size_t oldSize = ptr ? osize : 0;
+
+		if (nsize > oldSize and stats.limit != 0 and nsize - oldSize > stats.limit - std::min(stats.current, stats.limit)) {
+				limitHit = true;
+				return nullptr;
+				}
+
+		void* res;
+
+		if (inner) {
+				res = inner->reallocate(ptr, osize, nsize);
+				}
+		else if (nsize == 0) {
+				std::free(ptr);
+				res = nullptr;
+				}
+		else {
+				res = std::realloc(ptr, nsize);
+				}
+
+		if (nsize != 0 and !res) {
+				limitHit = false; // Real out of memory
+				return nullptr;
+				}
+
+		stats.current = stats.current - oldSize + nsize;
+		stats.peak = std::max(stats.peak, stats.current);
+
+		if (!ptr) ++stats.allocations;
+
+		if (nsize == 0 and ptr) ++stats.frees;
+
+		return res;
+		};
+
+	constexpr std::size_t PoolAllocator::slabHeaderSize() noexcept {
+		return (sizeof(Slab) + granularity - 1) / granularity * granularity;
+		};
+
+	namespace {
+		std::size_t classOf(std::size_t size) noexcept {
+			return size == 0 ? 0 : (size - 1) / PoolAllocator::granularity;
+			};
+		};
+
+	PoolAllocator::~PoolAllocator() {
+		// After lua_close every slab is either partial (shouldn't be) or cached
+		for (auto& sc : classes) {
+				while (sc.partial) {
+						auto next = sc.partial->next;
+						releaseSlab(sc.partial);
+						sc.partial = next;
+						}
+
+				if (sc.empty) releaseSlab(sc.empty);
+				}
+		};
+
+	PoolAllocator::Slab* PoolAllocator::slabOf(void* ptr) noexcept {
+		return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(ptr) & ~(slabSize - 1));
+		};
+
+	bool PoolAllocator::isSmall(void* ptr, std::size_t osize) const noexcept {
+		// Small blocks never grow past maxSmallSize
+		if (osize > maxSmallSize) return false;
+
+		// Only big blocks which failed to shrink make size lie
+		if (misfiled == 0) return true;
+
+		return slabs.count(slabOf(ptr)) != 0;
+		};
+
+	void PoolAllocator::releaseSlab(Slab* slab) noexcept {
+		slabs.erase(slab);
+		slab->~Slab();
+		std::free(slab);
+		--slabCount;
+		};
+
+	void* PoolAllocator::allocSmall(std::size_t cls) noexcept {
+		auto& sc = classes[cls];
+		auto blockSize = (cls + 1) * granularity;
+		Slab* slab = sc.partial;
+
+		if (!slab) {
+				if (sc.empty) {
+						slab = sc.empty;
+						sc.empty = nullptr;
+						}
+				else {
+						void* mem = std::aligned_alloc(slabSize, slabSize);
+
+						if (!mem) return nullptr;
+
+						try {
+								slabs.insert(static_cast<const Slab*>(mem));
+								}
+						catch (const std::bad_alloc&) {
+								std::free(mem);
+								return nullptr;
+								}
+
+						++slabCount;
+						slab = new(mem) Slab;
+						slab->cls = cls;
+						slab->bump = static_cast<char*>(mem) + slabHeaderSize();
+						slab->end = slab->bump + (slabSize - slabHeaderSize()) / blockSize * blockSize;
+						}
+
+				slab->prev = nullptr;
+				slab->next = nullptr;
+				sc.partial = slab;
+				}
+
+		void* block;
+
+		if (slab->freeList) {
+				block = slab->freeList;
+				slab->freeList = *static_cast<void**>(block);
+				}
+		else {
+				block = slab->bump;
+				slab->bump += blockSize;
+				}
+
+		++slab->used;
+
+		if (!slab->freeList and slab->bump == slab->end) {
+				// Full: it's first in list, so just drop it
+				sc.partial = slab->next;
+
+				if (sc.partial) sc.partial->prev = nullptr;
+				}
+
+		return block;
+		};
+
+	void PoolAllocator::freeSmall(void* ptr) noexcept {
+		auto slab = slabOf(ptr);
+		auto& sc = classes[slab->cls];
+		bool wasFull = !slab->freeList and slab->bump == slab->end;
+
+		*static_cast<void**>(ptr) = slab->freeList;
+		slab->freeList = ptr;
+		--slab->used;
+
+		if (wasFull) {
+				slab->prev = nullptr;
+				slab->next = sc.partial;
+
+				if (sc.partial) sc.partial->prev = slab;
+
+				sc.partial = slab;
+				}
+
+		if (slab->used == 0) {
+				// Unlink from partial list
+				if (slab->prev) slab->prev->next = slab->next;
+				else sc.partial = slab->next;
+
+				if (slab->next) slab->next->prev = slab->prev;
+
+				if (!sc.empty) {
+						// Keep it, but start from scratch
+						slab->freeList = nullptr;
+						slab->bump = reinterpret_cast<char*>(slab) + slabHeaderSize();
+						sc.empty = slab;
+						}
+				else {
+						releaseSlab(slab);
+						}
+				}
+		};
+
+	void* PoolAllocator::reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept {
+		if (!ptr) {
+				// osize is object type here
+				if (nsize == 0) return nullptr;
+
+				return nsize <= maxSmallSize ? allocSmall(classOf(nsize)) : std::malloc(nsize);
+				}
+
+		bool oldSmall = isSmall(ptr, osize);
+		bool wasMisfiled = !oldSmall and osize <= maxSmallSize;
+
+		if (nsize == 0) {
+				if (oldSmall) {
+						freeSmall(ptr);
+						}
+				else {
+						std::free(ptr);
+
+						if (wasMisfiled) --misfiled;
+						}
+
+				return nullptr;
+				}
+
+		bool newSmall = nsize <= maxSmallSize;
+
+		if (!oldSmall and !newSmall) {
+				void* res = std::realloc(ptr, nsize);
+
+				if (res and wasMisfiled) --misfiled;
+
+				return res;
+				}
+
+		if (oldSmall and newSmall and classOf(nsize) == slabOf(ptr)->cls) return ptr;
+
+		void* res = newSmall ? allocSmall(classOf(nsize)) : std::malloc(nsize);
+
+		if (!res) {
+				// Growing may fail, shrinking may not: keep block where it is
+				if (nsize > osize) return nullptr;
+
+				if (!oldSmall and !wasMisfiled) ++misfiled;
+
+				return ptr;
+				}
+
+		std::memcpy(res, ptr, std::min(osize, nsize));
+
+		if (oldSmall) {
+				freeSmall(ptr);
+				}
+		else {
+				std::free(ptr);
+
+				if (wasMisfiled) --misfiled;
+				}
+
+		return res;
+		};
+
+	/// Chunk header, placed at start of chunk.
+	struct ArenaAllocator::Chunk {
+		Chunk* next; ///< Next chunk in list.
+		};
+
+	/// Header of separately allocated block.
+	struct ArenaAllocator::Large {
+		Large* prev; ///< Previous block in list.
+		Large* next; ///< Next block in list.
+		};
+
+	namespace {
+		constexpr std::size_t alignUp(std::size_t size) noexcept {
+			return (size + ArenaAllocator::alignment - 1) / ArenaAllocator::alignment * ArenaAllocator::alignment;
+			};
+		};
+
+	ArenaAllocator::ArenaAllocator(std::size_t size):
+		chunkSize(std::max(alignUp(size), std::size_t(4096))),
+		largeThreshold(chunkSize / 8) {};
+
+	ArenaAllocator::~ArenaAllocator() {
+		reset(false);
+		};
+
+	void ArenaAllocator::reset(bool keepChunks) noexcept {
+		while (large) {
+				auto next = large->next;
+				std::free(large);
+				large = next;
+				}
+
+		// Move chunks in use to spare list
+		while (chunks) {
+				auto next = chunks->next;
+				chunks->next = spare;
+				spare = chunks;
+				chunks = next;
+				}
+
+		cur = end = nullptr;
+
+		if (!keepChunks) {
+				while (spare) {
+						auto next = spare->next;
+						std::free(spare);
+						spare = next;
+						--chunkCount;
+						}
+				}
+		};
+
+	bool ArenaAllocator::nextChunk() noexcept {
+		Chunk* chunk = spare;
+
+		if (chunk) {
+				spare = chunk->next;
+				}
+		else {
+				chunk = static_cast<Chunk*>(std::aligned_alloc(alignment, chunkSize));
+
+				if (!chunk) return false;
+
+				++chunkCount;
+				}
+
+		chunk->next = chunks;
+		chunks = chunk;
+		cur = reinterpret_cast<char*>(chunk) + alignUp(sizeof(Chunk));
+		end = reinterpret_cast<char*>(chunk) + chunkSize;
+		return true;
+		};
+
+	void* ArenaAllocator::allocLarge(std::size_t size) noexcept {
+		auto block = static_cast<Large*>(std::aligned_alloc(alignment, alignUp(sizeof(Large)) + alignUp(size)));
+
+		if (!block) return nullptr;
+
+		block->prev = nullptr;
+		block->next = large;
+
+		if (large) large->prev = block;
+
+		large = block;
+		return reinterpret_cast<char*>(block) + alignUp(sizeof(Large));
+		};
+
+	void ArenaAllocator::freeLarge(void* ptr) noexcept {
+		auto block = reinterpret_cast<Large*>(static_cast<char*>(ptr) - alignUp(sizeof(Large)));
+
+		if (block->prev) block->prev->next = block->next;
+		else large = block->next;
+
+		if (block->next) block->next->prev = block->prev;
+
+		std::free(block);
+		};
+
+	void* ArenaAllocator::allocate(std::size_t size) noexcept {
+		if (size > largeThreshold) return allocLarge(size);
+
+		size = alignUp(size);
+
+		if (static_cast<std::size_t>(end - cur) < size and !nextChunk()) return nullptr;
+
+		void* res = cur;
+		cur += size;
+		return res;
+		};
+
+	void* ArenaAllocator::reallocate(void* ptr, std::size_t osize, std::size_t nsize) noexcept {
+		if (!ptr) return nsize == 0 ? nullptr : allocate(nsize); // osize is object type here
+
+		bool oldLarge = osize > largeThreshold;
+		bool isLast = !oldLarge and static_cast<char*>(ptr) + alignUp(osize) == cur;
+
+		if (nsize == 0) {
+				if (oldLarge) freeLarge(ptr);
+				else if (isLast) cur = static_cast<char*>(ptr); // Take it back
+
+				return nullptr;
+				}
+
+		if (!oldLarge and nsize <= largeThreshold) {
+				if (isLast and alignUp(nsize) <= static_cast<std::size_t>(end - static_cast<char*>(ptr))) {
+						// Grow or shrink in place
+						cur = static_cast<char*>(ptr) + alignUp(nsize);
+						return ptr;
+						}
+
+				if (nsize <= osize) return ptr; // Tail is wasted until reset
+				}
+
+		void* res = allocate(nsize);
+
+		// Shrinking must not fail: large block just stays in list until reset
+		if (!res) return nsize <= osize ? ptr : nullptr;
+
+		std::memcpy(res, ptr, std::min(osize, nsize));
+
+		if (oldLarge) freeLarge(ptr);
+
+		return res;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,243 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include "lua.hpp"
+#include "lua++/BytecodeCache.hpp"
+
+namespace fs = std::filesystem;
+
+namespace Lua {
+	namespace {
+		constexpr std::uint64_t fnvOffset = 14695981039346656037ULL;
+		constexpr std::uint64_t fnvPrime = 1099511628211ULL;
+
+		std::uint64_t fnv1a(std::uint64_t h, std::string_view data) noexcept {
+			for (unsigned char c : data) {
+					h ^= c;
+					h *= fnvPrime;
+					}
+
+			return h;
+			};
+
+		/// MurmurHash64A by Austin Appleby (public domain).
+		std::uint64_t murmur64(std::uint64_t seed, std::string_view data) noexcept {
+			constexpr std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+			constexpr int r = 47;
+			std::uint64_t h = seed ^ (data.size() * m);
+			const char* p = data.data();
+			const char* end = p + data.size() / 8 * 8;
+
+			for (; p != end; p += 8) {
+					std::uint64_t k;
+					std::memcpy(&k, p, sizeof(k));
+					k *= m;
+					k ^= k >> r;
+					k *= m;
+					h ^= k;
+					h *= m;
+					}
+
+			if (auto rest = data.size() % 8) {
+					std::uint64_t tail = 0;
+
+					for (std::size_t i = 0; i < rest; ++i) {
+							tail |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+							}
+
+					h ^= tail;
+					h *= m;
+					}
+
+			h ^= h >> r;
+			h *= m;
+			h ^= h >> r;
+			return h;
+			};
+
+		/// Properties of %Lua build which make bytecode incompatible.
+		const std::string& buildTag() {
+			static const std::string tag = std::to_string(LUA_VERSION_NUM) + "/" + std::to_string(sizeof(lua_Integer)) + "/" + std::to_string(sizeof(lua_Number));
+			return tag;
+			};
+
+		constexpr std::string_view separator("\0", 1);
+
+		template<typename T>
+		void appendRaw(std::string& str, const T& value) {
+			str.append(reinterpret_cast<const char*>(&value), sizeof(value));
+			};
+		};
+
+	BytecodeCache::BytecodeCache(std::size_t maxMem, fs::path dir, bool stripDebug):
+		maxMemory(maxMem),
+		directory(std::move(dir)),
+		strip(stripDebug),
+		tmpSalt(std::random_device()()) {
+		if (!directory.empty()) {
+				std::error_code ec;
+				fs::create_directories(directory, ec);
+
+				if (ec) directory.clear(); // Work as memory-only cache
+				}
+		};
+
+	BytecodeCache::Key BytecodeCache::hash(std::string_view source, std::string_view name) noexcept {
+		const auto& tag = buildTag();
+		Key key;
+		auto h = fnv1a(fnvOffset, tag);
+		h = fnv1a(h, separator);
+		h = fnv1a(h, name);
+		h = fnv1a(h, separator);
+		key.hash = fnv1a(h, source);
+		key.check = murmur64(murmur64(murmur64(0, tag), name), source);
+		key.length = source.size();
+		return key;
+		};
+
+	fs::path BytecodeCache::pathFor(const Key& key) const {
+		char buf[17];
+		std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key.hash));
+		// Stripped and full chunks for same source are different files
+		return directory / (std::string(buf) + (strip ? "-s.luac" : ".luac"));
+		};
+
+	std::string BytecodeCache::fileHeader(const Key& key) const {
+		std::string res = "lua++bc ";
+		res += buildTag();
+		res += strip ? " s" : " f";
+		res += separator;
+		appendRaw(res, key.check);
+		appendRaw(res, key.length);
+		return res;
+		};
+
+	void BytecodeCache::insert(const Key& key, Chunk chunk) {
+		if (chunk->size() > maxMemory) return; // Would evict everything and still not fit
+
+		if (auto it = index.find(key); it != index.end()) {
+				stats.memoryBytes -= it->second->second->size();
+				lru.erase(it->second);
+				index.erase(it);
+				}
+
+		stats.memoryBytes += chunk->size();
+		lru.emplace_front(key, std::move(chunk));
+		index[key] = lru.begin();
+
+		while (stats.memoryBytes > maxMemory) {
+				auto& last = lru.back();
+				stats.memoryBytes -= last.second->size();
+				index.erase(last.first);
+				lru.pop_back();
+				}
+		};
+
+	BytecodeCache::Chunk BytecodeCache::find(const Key& key) {
+			{
+			std::lock_guard lock(mutex);
+
+			if (auto it = index.find(key); it != index.end()) {
+					// Move to front
+					lru.splice(lru.begin(), lru, it->second);
+					++stats.hits;
+					return it->second->second;
+					}
+
+			if (directory.empty()) {
+					++stats.misses;
+					return nullptr;
+					}
+			}
+
+		// Disk lookup is done without lock
+		std::ifstream fin(pathFor(key), std::ios::binary);
+		const auto header = fileHeader(key);
+		std::string storedHeader(header.size(), '\0');
+
+		// Different header means collision of primary hash or foreign file: don't use it
+		if (fin.read(storedHeader.data(), storedHeader.size()) and storedHeader == header) {
+				auto chunk = std::make_shared<const std::string>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+
+				if (!chunk->empty()) {
+						std::lock_guard lock(mutex);
+						++stats.diskHits;
+						insert(key, chunk);
+						return chunk;
+						}
+				}
+
+		std::lock_guard lock(mutex);
+		++stats.misses;
+		return nullptr;
+		};
+
+	void BytecodeCache::store(const Key& key, std::string bytecode) {
+		auto chunk = std::make_shared<const std::string>(std::move(bytecode));
+		std::uint64_t tmpId = 0;
+			{
+			std::lock_guard lock(mutex);
+			insert(key, chunk);
+			tmpId = tmpCounter++;
+			}
+
+		if (directory.empty()) return;
+
+		// Write to unique temporary file, then atomically replace target
+		auto target = pathFor(key);
+		auto tmp = target;
+		tmp += ".tmp." + std::to_string(tmpSalt) + "." + std::to_string(tmpId);
+			{
+			const auto header = fileHeader(key);
+			std::ofstream fout(tmp, std::ios::binary | std::ios::trunc);
+			fout.write(header.data(), header.size());
+			fout.write(chunk->data(), chunk->size());
+
+			if (!fout) {
+					fout.close();
+					std::error_code ec;
+					fs::remove(tmp, ec);
+					return;
+					}
+			}
+
+		std::error_code ec;
+		fs::rename(tmp, target, ec);
+
+		if (ec) fs::remove(tmp, ec);
+		};
+
+	void BytecodeCache::erase(const Key& key) {
+			{
+			std::lock_guard lock(mutex);
+
+			if (auto it = index.find(key); it != index.end()) {
+					stats.memoryBytes -= it->second->second->size();
+					lru.erase(it->second);
+					index.erase(it);
+					}
+			}
+
+		if (!directory.empty()) {
+				std::error_code ec;
+				fs::remove(pathFor(key), ec);
+				}
+		};
+
+	void BytecodeCache::clear() {
+		std::lock_guard lock(mutex);
+		lru.clear();
+		index.clear();
+		stats.memoryBytes = 0;
+		};
+
+	BytecodeCache::Stats BytecodeCache::getStats() const {
+		std::lock_guard lock(mutex);
+		auto res = stats;
+		res.entries = lru.size();
+		return res;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "lua++/CallStats.hpp"
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#define LUAPP_HAVE_CXXABI 1
+#endif
+
+namespace Lua {
+	std::chrono::nanoseconds CallStats::Binding::percentile(double p) const noexcept {
+		auto target = static_cast<std::uint64_t>(p * calls);
+		std::uint64_t seen = 0;
+
+		for (std::size_t i = 0; i < bucketCount; ++i) {
+				seen += histogram[i];
+
+				// Last bucket is unbounded
+				if ((seen > target or seen == calls) and i + 1 < bucketCount) return std::min(std::chrono::nanoseconds(std::int64_t(1) << i), max);
+				}
+
+		return max;
+		};
+
+	void CallStats::record(Binding& binding, std::chrono::nanoseconds duration) noexcept {
+		auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0));
+		std::size_t bucket = 0;
+
+		// Number of significant bits
+		while (ns >> bucket and bucket < bucketCount - 1) ++bucket;
+
+		++binding.calls;
+		binding.total += duration;
+		binding.max = std::max(binding.max, duration);
+		++binding.histogram[bucket];
+		};
+
+	void CallStats::writeReport(std::ostream& out) const {
+		std::vector<const std::pair<const std::string, Binding>*> sorted;
+
+		for (const auto& entry : bindings) sorted.push_back(&entry);
+
+		std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) {
+			return a->second.total > b->second.total;
+			});
+
+		for (auto entry : sorted) {
+				const auto& [name, b] = *entry;
+				out << name << '\t' << b.calls << '\t' << b.total.count() << '\t' << b.mean().count() << '\t'
+					<< b.percentile(0.5).count() << '\t' << b.percentile(0.99).count() << '\t' << b.max.count() << '\n';
+				}
+		};
+
+	std::string CallStats::typeName(const std::type_info& type) {
+		std::string res = type.name();
+#ifdef LUAPP_HAVE_CXXABI
+		int status = 0;
+		std::unique_ptr<char, decltype(&std::free)> demangled(abi::__cxa_demangle(type.name(), nullptr, nullptr, &status), &std::free);
+
+		if (status == 0 and demangled) res = demangled.get();
+#endif
+		return res;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
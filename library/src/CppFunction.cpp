@@ -1,14 +1,17 @@
 #include "lua++/CppFunction.hpp"
 #include "lua++/Error.hpp"
 #include <cassert>
+#include <new>
 
 namespace Lua {
 
 	int TypeCppFunction::gc(lua_State* L) {
 		if (checkCppType<CppFunction>(L, 1, tname) == cppTypeCheckResult::OK) { // Valid object
-				auto ptr = static_cast<CppFunction**>(lua_touserdata(L, 1));
-				delete *ptr;
-				*ptr = nullptr;
+				auto data = static_cast<FunctionData*>(lua_touserdata(L, 1));
+				delete data->func;
+				data->func = nullptr;
+				delete data->name;
+				data->name = nullptr;
 				}
 
 		// No worries, it's probably just closed
@@ -18,9 +21,17 @@ namespace Lua {
 
 	int TypeCppFunction::call(lua_State* L) {
 		if (checkCppType<CppFunction>(L, 1, tname) == cppTypeCheckResult::OK) { // Valid object
-				auto ptr = static_cast<CppFunction**>(lua_touserdata(L, 1));
+				auto data = static_cast<FunctionData*>(lua_touserdata(L, 1));
 				auto Lp = StatePtr(L);
-				return LuaErrorWrapper(L, **ptr, {Lp});
+
+				int nres;
+
+				if (auto stats = Lp->activeCallStats()) nres = callRecorded(L, *data, Lp, *stats);
+				else nres = LuaErrorWrapper(L, *data->func, {Lp});
+
+				// Count hooks don't fire inside C++ code, so sample time spent there now (binding is still on top)
+				State::profilerTick(L);
+				return nres;
 				}
 		else {
 				luaL_error(L, "Call to closed or invalid CppFunction");
@@ -28,6 +39,61 @@ namespace Lua {
 				}
 		};
 
+	bool TypeCppFunction::isBinding(lua_CFunction func) noexcept {
+		return func == call or func == TypeCppFunctionWrapper::call;
+		};
+
+	int TypeCppFunction::callRecorded(lua_State* L, FunctionData& data, StatePtr& Lp, CallStats& stats) {
+		// Stack: function object, args
+		CallStats::Binding* binding;
+
+		if (data.name) {
+				// Resolved once (and again after reset)
+				if (data.stats != &stats or data.generation != stats.getGeneration()) {
+						data.binding = &stats.getBinding(*data.name);
+						data.stats = &stats;
+						data.generation = stats.getGeneration();
+						}
+
+				binding = data.binding;
+				}
+		else {
+				// Name it was called by
+				lua_Debug ar;
+				bool named = lua_getstack(L, 0, &ar) and lua_getinfo(L, "n", &ar) and ar.name;
+				binding = &stats.getBinding(named ? ar.name : "?");
+				}
+
+		// Also records calls ended by error
+		struct Timer {
+			CallStats& stats;
+			CallStats::Binding& binding;
+			std::uint64_t generation = stats.getGeneration();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			~Timer() {
+				// Binding may be gone if statistics were reset by call itself
+				if (stats.getGeneration() == generation) CallStats::record(binding, std::chrono::steady_clock::now() - start);
+				};
+			} timer {stats, *binding};
+
+		return LuaErrorWrapper(L, *data.func, {Lp});
+		};
+
+	void TypeCppFunction::setName(lua_State* L, int idx, const std::string& name) {
+		auto data = static_cast<FunctionData*>(lua_touserdata(L, idx));
+		auto newName = new std::string(name);
+		delete data->name;
+		data->name = newName;
+		data->stats = nullptr;
+		};
+
+	const std::string* TypeCppFunction::getName(lua_State* L, int idx) noexcept {
+		if (checkCppType<CppFunction>(L, idx, tname) != cppTypeCheckResult::OK) return nullptr;
+
+		return static_cast<FunctionData*>(lua_touserdata(L, idx))->name;
+		};
+
 	void TypeCppFunction::init(Lua::State& L) const {
 		[[maybe_unused]] auto mtok = luaL_newmetatable(L, tname);
 		assert(mtok);
@@ -50,20 +116,27 @@ namespace Lua {
 		};
 
 	std::any TypeCppFunction::getValue(lua_State* L, int idx) const {
-		auto ptr = static_cast<CppFunction**>(lua_touserdata(L, idx));
-		return CppFunction(**ptr);
+		auto data = static_cast<FunctionData*>(lua_touserdata(L, idx));
+		return CppFunction(*data->func);
 		};
 
 	void TypeCppFunction::pushValue(lua_State* L, const std::any& obj) const {
 		auto& origFunc = std::any_cast<std::reference_wrapper<const CppFunction>>(obj).get();
 		// Based on as TypeHelper
-		auto newptr = static_cast<CppFunction**>(lua_newuserdatauv(L, sizeof(CppFunction*), 0));
-		// First make sure that it is nullptr if `__gc` will be called
-		*newptr = nullptr;
+		auto data = new (lua_newuserdatauv(L, sizeof(FunctionData), 0)) FunctionData;
+		// First make sure that it is nullptr if `__gc` will be called (by constructing it)
 		// Then add `_gc`
 		luaL_setmetatable(L, tname);
 		// And only THEN add real data
-		*newptr = new CppFunction(origFunc);
+		data->func = new CppFunction(origFunc);
+		};
+
+	bool TypeCppFunction::moveValue(lua_State* L, const std::any& obj) const {
+		auto& origFunc = std::any_cast<std::reference_wrapper<CppFunction>>(obj).get();
+		auto data = new (lua_newuserdatauv(L, sizeof(FunctionData), 0)) FunctionData;
+		luaL_setmetatable(L, tname);
+		data->func = new CppFunction(std::move(origFunc));
+		return true;
 		};
 
 	const std::type_info& TypeCppFunctionWrapper::getType() const noexcept {
@@ -128,10 +201,19 @@ namespace Lua {
 	void TypeCppFunctionWrapper::pushValue(lua_State* L, const std::any& obj) const {
 		auto& origFunc = std::any_cast<std::reference_wrapper<const CppFunctionWrapper>>(obj).get();
 		// Push internal function
-		StatePtr(L)->push<CppFunction>(origFunc.func);
+		StatePtr(L)->push(origFunc.func);
 		lua_pushlightuserdata(L, getId());
 		// Pop internal function, push wrapper
 		lua_pushcclosure(L, call, 2);
 		};
+
+	bool TypeCppFunctionWrapper::moveValue(lua_State* L, const std::any& obj) const {
+		auto& origFunc = std::any_cast<std::reference_wrapper<CppFunctionWrapper>>(obj).get();
+		// Same as above, but let internal function steal the object
+		StatePtr(L)->push(std::move(origFunc.func));
+		lua_pushlightuserdata(L, getId());
+		lua_pushcclosure(L, call, 2);
+		return true;
+		};
 	};
 // kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4; 
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <climits>
+#include "lua++/GarbageCollector.hpp"
+
+namespace Lua {
+	GarbageCollector::GarbageCollector(lua_State* L) noexcept: state(L) {};
+
+	GarbageCollector::Mode GarbageCollector::incremental(int pause, int stepmul, int stepsize) noexcept {
+		return static_cast<Mode>(lua_gc(state, LUA_GCINC, pause, stepmul, stepsize));
+		};
+
+	GarbageCollector::Mode GarbageCollector::generational(int minormul, int majormul) noexcept {
+		return static_cast<Mode>(lua_gc(state, LUA_GCGEN, minormul, majormul));
+		};
+
+	void GarbageCollector::collect() {
+		lua_gc(state, LUA_GCCOLLECT);
+		};
+
+	void GarbageCollector::stop() noexcept {
+		lua_gc(state, LUA_GCSTOP);
+		};
+
+	void GarbageCollector::restart() noexcept {
+		lua_gc(state, LUA_GCRESTART);
+		};
+
+	bool GarbageCollector::isRunning() const noexcept {
+		return lua_gc(state, LUA_GCISRUNNING) != 0;
+		};
+
+	std::size_t GarbageCollector::count() const noexcept {
+		return static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNT)) * 1024 + lua_gc(state, LUA_GCCOUNTB);
+		};
+
+	GarbageCollector::StepResult GarbageCollector::step(std::size_t kbytes) {
+		StepResult res;
+		auto before = count();
+		auto start = std::chrono::steady_clock::now();
+
+		// Negative result means that collector can't run right now (i.e. inside finalizer)
+		int finished = lua_gc(state, LUA_GCSTEP, static_cast<int>(std::min<std::size_t>(kbytes, INT_MAX)));
+
+		res.elapsed = std::chrono::steady_clock::now() - start;
+		res.steps = finished >= 0 ? 1 : 0;
+		res.cycleFinished = finished > 0;
+		auto after = count();
+		res.freed = before > after ? before - after : 0;
+		return res;
+		};
+
+	GarbageCollector::StepResult GarbageCollector::step(std::chrono::steady_clock::duration budget) {
+		StepResult res;
+		auto before = count();
+		auto start = std::chrono::steady_clock::now();
+		auto deadline = start + budget;
+
+		for (auto now = start; now < deadline; now = std::chrono::steady_clock::now()) {
+				int finished = lua_gc(state, LUA_GCSTEP, 0);
+
+				if (finished < 0) break;
+
+				++res.steps;
+
+				if (finished > 0) {
+						res.cycleFinished = true;
+						break;
+						}
+				}
+
+		res.elapsed = std::chrono::steady_clock::now() - start;
+		auto after = count();
+		res.freed = before > after ? before - after : 0;
+		return res;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
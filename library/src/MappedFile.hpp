@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+/**
+ * @file MappedFile.hpp
+ * @brief Internal helper for memory-mapped files (not part of public API)
+*/
+
+#if __has_include(<sys/mman.h>)
+#define LUAPP_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Lua {
+	/**
+	 * @brief Read-only memory mapping of regular file.
+	 *
+	 * Mapping fails (and object is left invalid) for anything but non-empty
+	 * regular files, so pipes and devices go through stream path.
+	 *
+	 * @warning Truncating file while it's mapped results in `SIGBUS`.
+	*/
+	class MappedFile {
+		private:
+			void* addr = MAP_FAILED; ///< Start of mapping.
+			std::size_t size = 0;    ///< Length of mapping.
+		public:
+			/**
+			 * @brief Main constructor
+			 *
+			 * @param filename File to be mapped.
+			 * @param sequential File will be read from start to end (hint for kernel).
+			*/
+			explicit MappedFile(const std::string& filename, bool sequential = true) {
+				int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+				if (fd < 0) return;
+
+				struct stat st;
+
+				if (::fstat(fd, &st) == 0 and S_ISREG(st.st_mode) and st.st_size > 0) {
+						addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+						if (addr != MAP_FAILED) {
+								size = st.st_size;
+								::madvise(addr, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+								}
+						}
+
+				::close(fd); // Mapping stays valid
+				};
+			MappedFile(const MappedFile&) = delete; ///< Explicitly deleted to prevent copy.
+			MappedFile& operator=(const MappedFile&) = delete; ///< Explicitly deleted to prevent copy.
+			~MappedFile() {
+				if (addr != MAP_FAILED) ::munmap(addr, size);
+				};
+
+			/// Was file mapped successfully.
+			[[nodiscard]] bool valid() const noexcept { return addr != MAP_FAILED; };
+			/// Get mapped data.
+			[[nodiscard]] std::string_view view() const noexcept { return {static_cast<const char*>(addr), size}; };
+		};
+	};
+#endif
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,139 @@
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include "lua++/ModuleArchive.hpp"
+#include "lua++/Error.hpp"
+#include "MappedFile.hpp"
+
+namespace Lua {
+	namespace {
+		constexpr std::string_view archiveMagic("LUA++AR\0", 8);
+		constexpr std::uint32_t archiveVersion = 1;
+		constexpr std::size_t headerSize = 16;
+		constexpr std::size_t entrySize = 32;
+
+		std::uint64_t readLE(const char* p, std::size_t bytes) noexcept {
+			std::uint64_t res = 0;
+
+			for (std::size_t i = bytes; i-- > 0;) {
+					res = (res << 8) | static_cast<unsigned char>(p[i]);
+					}
+
+			return res;
+			};
+
+		void writeLE(std::string& out, std::uint64_t value, std::size_t bytes) {
+			for (std::size_t i = 0; i < bytes; ++i) {
+					out += static_cast<char>(value & 0xFF);
+					value >>= 8;
+					}
+			};
+		};
+
+	ModuleArchive::ModuleArchive(const std::string& fname): filename(fname) {
+#ifdef LUAPP_HAVE_MMAP
+		// Lookups jump all over the file
+		auto file = std::make_shared<const MappedFile>(filename, false);
+
+		if (file->valid()) {
+				data = file->view();
+				storage = file;
+				}
+#endif
+
+		if (!storage) {
+				std::ifstream fin(filename, std::ios::binary);
+
+				if (!fin) throw Lua::Error("Can't open module archive \"" + filename + "\"");
+
+				auto buffer = std::make_shared<const std::string>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+				data = *buffer;
+				storage = buffer;
+				}
+
+		if (data.size() < headerSize or data.substr(0, archiveMagic.size()) != archiveMagic) {
+				throw Lua::Error("\"" + filename + "\" is not a module archive");
+				}
+
+		if (readLE(data.data() + 8, 4) != archiveVersion) {
+				throw Lua::Error("Unsupported module archive version in \"" + filename + "\"");
+				}
+
+		count = readLE(data.data() + 12, 4);
+
+		// Validate everything once, so lookups don't have to
+		if (count > (data.size() - headerSize) / entrySize) {
+				throw Lua::Error("Module archive \"" + filename + "\" is truncated");
+				}
+
+		for (std::size_t i = 0; i < count; ++i) {
+				auto entry = data.data() + headerSize + i * entrySize;
+
+				for (std::size_t field = 0; field < 4; field += 2) {
+						auto offset = readLE(entry + field * 8, 8);
+						auto size = readLE(entry + field * 8 + 8, 8);
+
+						if (offset > data.size() or size > data.size() - offset) {
+								throw Lua::Error("Module archive \"" + filename + "\" is truncated");
+								}
+						}
+
+				if (i > 0 and !(nameAt(i - 1) < nameAt(i))) {
+						throw Lua::Error("Module archive \"" + filename + "\" has unsorted index");
+						}
+				}
+		};
+
+	std::string_view ModuleArchive::nameAt(std::size_t i) const {
+		auto entry = data.data() + headerSize + i * entrySize;
+		return data.substr(readLE(entry, 8), readLE(entry + 8, 8));
+		};
+
+	std::string_view ModuleArchive::chunkAt(std::size_t i) const {
+		auto entry = data.data() + headerSize + i * entrySize;
+		return data.substr(readLE(entry + 16, 8), readLE(entry + 24, 8));
+		};
+
+	std::optional<std::string_view> ModuleArchive::find(std::string_view name) const {
+		std::size_t lo = 0, hi = count;
+
+		while (lo < hi) {
+				auto mid = lo + (hi - lo) / 2;
+				auto cmp = nameAt(mid).compare(name);
+
+				if (cmp == 0) return chunkAt(mid);
+				else if (cmp < 0) lo = mid + 1;
+				else hi = mid;
+				}
+
+		return std::nullopt;
+		};
+
+	void ModuleArchive::write(const std::string& filename, const std::map<std::string, std::string>& modules) {
+		if (modules.size() > UINT32_MAX) throw Lua::Error("Too many modules for single archive");
+
+		// std::map is already sorted bytewise
+		std::string index;
+		std::string payload;
+		std::uint64_t base = headerSize + modules.size() * entrySize;
+
+		for (const auto& [name, chunk] : modules) {
+				writeLE(index, base + payload.size(), 8);
+				writeLE(index, name.size(), 8);
+				payload += name;
+				writeLE(index, base + payload.size(), 8);
+				writeLE(index, chunk.size(), 8);
+				payload += chunk;
+				}
+
+		std::string header(archiveMagic);
+		writeLE(header, archiveVersion, 4);
+		writeLE(header, modules.size(), 4);
+
+		std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+		fout << header << index << payload;
+
+		if (!fout) throw Lua::Error("Can't write module archive \"" + filename + "\"");
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,180 @@
+#include <array>
+#include <system_error>
+#include "lua++/ModuleDirectory.hpp"
+#include "lua++/Error.hpp"
+
+#if __has_include(<sys/inotify.h>)
+#define LUAPP_HAVE_INOTIFY 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace Lua {
+	ModuleDirectory::ModuleDirectory(fs::path dir) {
+		std::error_code ec;
+
+		if (!fs::is_directory(dir, ec)) throw Lua::Error("\"" + dir.string() + "\" is not a directory");
+
+		root = fs::canonical(dir, ec);
+
+		if (ec) throw Lua::Error("Can't resolve \"" + dir.string() + "\": " + ec.message());
+
+		std::lock_guard lock(mutex);
+		rebuild();
+		};
+
+	ModuleDirectory::~ModuleDirectory() {
+#ifdef LUAPP_HAVE_INOTIFY
+		if (watcher.joinable()) {
+				[[maybe_unused]] auto res = ::write(stopFd[1], "", 1);
+				watcher.join();
+				}
+
+		for (int fd : {inotifyFd, stopFd[0], stopFd[1]}) {
+				if (fd >= 0) ::close(fd);
+				}
+#endif
+		};
+
+	void ModuleDirectory::rebuild() {
+		stale = false; // Changes made during scan will trigger another one
+		index.clear();
+
+		auto addWatch = [this]([[maybe_unused]] const fs::path & dir) {
+#ifdef LUAPP_HAVE_INOTIFY
+			if (inotifyFd >= 0) {
+					inotify_add_watch(inotifyFd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+					}
+#endif
+			};
+		addWatch(root);
+
+		std::error_code ec;
+
+		for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end; !ec and it != end; it.increment(ec)) {
+				const auto& entry = *it;
+				auto filename = entry.path().filename().string();
+				std::error_code entryEc; // Errors here must not stop iteration
+
+				// Symbolic links may point out of root
+				if (entry.is_symlink(entryEc)) {
+						continue;
+						}
+
+				if (entry.is_directory(entryEc)) {
+						// Such directory can't be part of module name (and it's probably .git or similar)
+						if (filename.find('.') != std::string::npos) it.disable_recursion_pending();
+						else addWatch(entry.path());
+
+						continue;
+						}
+
+				if (!entry.is_regular_file(entryEc) or entry.path().extension() != ".lua") continue;
+
+				// Parent directories are checked above
+				auto stem = entry.path().stem().string();
+
+				if (stem.empty() or stem.find('.') != std::string::npos) continue;
+
+				std::string prefix;
+
+				for (const auto& part : entry.path().parent_path().lexically_relative(root)) {
+						if (part != ".") prefix += part.string() + ".";
+						}
+
+				// `?.lua` takes priority over `?/init.lua`
+				if (stem == "init" and !prefix.empty()) {
+						index.try_emplace(prefix.substr(0, prefix.size() - 1), entry.path().string());
+						}
+
+				index.insert_or_assign(prefix + stem, entry.path().string());
+				}
+		};
+
+	std::optional<std::string> ModuleDirectory::find(std::string_view name) {
+		std::lock_guard lock(mutex);
+
+		if (stale) rebuild();
+
+		if (auto it = index.find(std::string(name)); it != index.end()) {
+				return it->second;
+				}
+
+		return std::nullopt;
+		};
+
+	void ModuleDirectory::refresh() {
+		std::lock_guard lock(mutex);
+		rebuild();
+		};
+
+	std::size_t ModuleDirectory::size() const {
+		std::lock_guard lock(mutex);
+		return index.size();
+		};
+
+	bool ModuleDirectory::watch() {
+#ifdef LUAPP_HAVE_INOTIFY
+		std::lock_guard lock(mutex);
+
+		if (inotifyFd >= 0) return true;
+
+		int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+
+		if (fd < 0) return false;
+
+		if (::pipe2(stopFd, O_CLOEXEC) != 0) {
+				::close(fd);
+				return false;
+				}
+
+		inotifyFd = fd;
+		rebuild(); // Adds watches for all directories
+
+		try {
+				watcher = std::thread(&ModuleDirectory::watchLoop, this);
+				}
+		catch (const std::system_error&) {
+				::close(inotifyFd);
+				::close(stopFd[0]);
+				::close(stopFd[1]);
+				inotifyFd = stopFd[0] = stopFd[1] = -1;
+				return false;
+				}
+
+		return true;
+#else
+		return false;
+#endif
+		};
+
+	void ModuleDirectory::watchLoop() {
+#ifdef LUAPP_HAVE_INOTIFY
+		std::array<pollfd, 2> fds {{{inotifyFd, POLLIN, 0}, {stopFd[0], POLLIN, 0}}};
+		alignas(inotify_event) char buf[4096];
+
+		while (true) {
+				if (::poll(fds.data(), fds.size(), -1) < 0) {
+						if (errno == EINTR) continue;
+
+						break;
+						}
+
+				if (fds[1].revents != 0) break;
+
+				if (fds[0].revents & POLLIN) {
+						// Details are irrelevant, just drain queue
+						while (::read(inotifyFd, buf, sizeof(buf)) > 0) {}
+
+						stale = true;
+						}
+				}
+#endif
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
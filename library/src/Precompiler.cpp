@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include "lua++/Precompiler.hpp"
+
+namespace Lua {
+	void Precompiler::Result::load(State& L) const {
+		if (error) throw *error;
+
+		L.load(bytecode, name, LoadMode::BINARY);
+		};
+
+	Precompiler& Precompiler::addSource(std::string code, std::string name) {
+		inputs.push_back({std::move(name), std::move(code), false});
+		return *this;
+		};
+
+	Precompiler& Precompiler::addFile(const std::string& filename) {
+		inputs.push_back({"@" + filename, filename, true});
+		return *this;
+		};
+
+	std::vector<Precompiler::Result> Precompiler::run(unsigned threads) const {
+		std::vector<Result> results(inputs.size());
+		std::atomic<std::size_t> next {0};
+		std::mutex errorMutex;
+		std::exception_ptr fatal;
+
+		auto worker = [this, &results, &next, &errorMutex, &fatal] {
+			try {
+					// Parser needs no libraries
+					State L(DefaultLibsPreset::NONE);
+					L.registerStandardTypes();
+
+					for (std::size_t i; (i = next++) < inputs.size();) {
+							const auto& input = inputs[i];
+							auto& result = results[i];
+							result.name = input.name;
+
+							try {
+									if (input.isFile) L.loadFile(input.source);
+									else L.load(input.source, input.name);
+
+									result.bytecode = L.dump(stripDebug);
+									}
+							catch (const SyntaxError& err) {
+									result.error = err;
+									}
+
+							lua_settop(L, 0);
+							}
+					}
+			catch (...) {
+					next = inputs.size(); // Make other workers stop
+					std::lock_guard lock(errorMutex);
+
+					if (!fatal) fatal = std::current_exception();
+					}
+			};
+
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+		threads = std::min<std::size_t>(threads, std::max<std::size_t>(inputs.size(), 1));
+		std::vector<std::thread> pool;
+		pool.reserve(threads - 1);
+
+		for (unsigned i = 1; i < threads; ++i) {
+				try {
+						pool.emplace_back(worker);
+						}
+				catch (const std::system_error&) {
+						break; // Go on with threads we already have
+						}
+				}
+
+		worker();
+
+		for (auto& thread : pool) {
+				thread.join();
+				}
+
+		if (fatal) std::rethrow_exception(fatal);
+
+		return results;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
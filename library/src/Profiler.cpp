@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "lua++/Profiler.hpp"
+#include "lua++/CppFunction.hpp"
+
+namespace Lua {
+	namespace {
+		/// Name of frame at given level (function is left on stack by `lua_getinfo`).
+		std::string frameName(lua_State* L, lua_Debug& ar) {
+			lua_getinfo(L, "Snf", &ar);
+			// Stack: xxx, function
+			bool binding = lua_iscfunction(L, -1) and TypeCppFunction::isBinding(lua_tocfunction(L, -1));
+			lua_pop(L, 1);
+			// Stack: xxx
+
+			std::string res;
+
+			// Binding is named like in CallStats: function object is first argument of `__call`
+			// (or inserted there by CppFunctionWrapper)
+			if (binding and lua_getlocal(L, &ar, 1)) {
+					if (auto name = TypeCppFunction::getName(L, -1)) res = *name;
+
+					lua_pop(L, 1);
+					}
+
+			if (!res.empty()) {
+					// Already named
+					}
+			else if (ar.name) {
+					res = ar.name;
+					}
+			else if (*ar.what == 'm') {
+					res = "main chunk";
+					}
+			else {
+					res = "?";
+					}
+
+			if (binding) {
+					res += " [C++]";
+					}
+			else if (*ar.what == 'C') {
+					res += " [C]";
+					}
+			else {
+					res += " (";
+					res += ar.short_src;
+					res += ":" + std::to_string(ar.linedefined) + ")";
+					}
+
+			// Characters with special meaning in folded format
+			std::replace(res.begin(), res.end(), ';', ':');
+			std::replace(res.begin(), res.end(), '\n', ' ');
+			return res;
+			};
+		};
+
+	Profiler::Profiler(std::chrono::steady_clock::duration sampleInterval, std::size_t depth):
+		interval(sampleInterval),
+		nextSample(std::chrono::steady_clock::now() + sampleInterval),
+		maxDepth(depth) {};
+
+	bool Profiler::due() noexcept {
+		auto now = std::chrono::steady_clock::now();
+
+		if (now < nextSample) return false;
+
+		nextSample = now + interval;
+		return true;
+		};
+
+	void Profiler::sample(lua_State* L) noexcept {
+		try {
+				// Innermost frame first
+				std::vector<std::string> frames;
+				lua_Debug ar;
+
+				for (int level = 0; frames.size() < maxDepth and lua_getstack(L, level, &ar); ++level) {
+						frames.push_back(frameName(L, ar));
+						}
+
+				if (frames.empty()) return;
+
+				std::string key;
+
+				for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+						if (!key.empty()) key += ';';
+
+						key += *it;
+						}
+
+				++stacks[key];
+				++samples;
+				}
+		catch (const std::bad_alloc&) {
+				// Just lose this sample
+				}
+		};
+
+	void Profiler::reset() noexcept {
+		stacks.clear();
+		samples = 0;
+		};
+
+	void Profiler::writeFolded(std::ostream& out) const {
+		for (const auto& [stack, count] : stacks) {
+				out << stack << ' ' << count << '\n';
+				}
+		};
+
+	std::string Profiler::folded() const {
+		std::ostringstream out;
+		writeFolded(out);
+		return out.str();
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
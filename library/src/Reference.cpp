@@ -0,0 +1,83 @@
+#include <utility>
+#include "lua++/Reference.hpp"
+
+namespace Lua {
+	lua_State* Reference::getMainThread(lua_State* L) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+		auto res = lua_tothread(L, -1);
+		lua_pop(L, 1);
+		return res;
+		};
+
+	Reference::Reference(lua_State* Lt, int idx) {
+		luaL_checkstack(Lt, 1, nullptr);
+		lua_pushvalue(Lt, idx);
+		ref = luaL_ref(Lt, LUA_REGISTRYINDEX);
+		L = getMainThread(Lt);
+		};
+
+	Reference::Reference(const Reference& old): L(old.L) {
+		if (L and old.ref != LUA_NOREF) {
+				luaL_checkstack(L, 1, nullptr);
+				lua_rawgeti(L, LUA_REGISTRYINDEX, old.ref);
+				ref = luaL_ref(L, LUA_REGISTRYINDEX);
+				}
+		};
+
+	Reference::Reference(Reference&& old) noexcept:
+		L(std::exchange(old.L, nullptr)),
+		ref(std::exchange(old.ref, LUA_NOREF)) {};
+
+	Reference& Reference::operator=(const Reference& old) {
+		if (this != &old) {
+				*this = Reference(old);
+				}
+
+		return *this;
+		};
+
+	Reference& Reference::operator=(Reference&& old) noexcept {
+		if (this != &old) {
+				reset();
+				L = std::exchange(old.L, nullptr);
+				ref = std::exchange(old.ref, LUA_NOREF);
+				}
+
+		return *this;
+		};
+
+	Reference::~Reference() {
+		reset();
+		};
+
+	int Reference::push(lua_State* to) const {
+		luaL_checkstack(to, 1, nullptr);
+
+		if (!L or ref == LUA_NOREF or ref == LUA_REFNIL) {
+				lua_pushnil(to);
+				return LUA_TNIL;
+				}
+
+		return lua_rawgeti(to, LUA_REGISTRYINDEX, ref);
+		};
+
+	int Reference::getType() const noexcept {
+		if (!valid()) return LUA_TNIL;
+
+		if (!lua_checkstack(L, 1)) return LUA_TNONE;
+
+		int type = lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+		lua_pop(L, 1);
+		return type;
+		};
+
+	void Reference::reset() noexcept {
+		if (L) {
+				luaL_unref(L, LUA_REGISTRYINDEX, ref);
+				}
+
+		L = nullptr;
+		ref = LUA_NOREF;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include "lua++/Scheduler.hpp"
+#include "lua++/Error.hpp"
+
+namespace Lua {
+	namespace {
+		thread_local Scheduler* runningScheduler = nullptr; ///< Scheduler running task on this thread.
+		};
+
+	Scheduler::Scheduler(State& state, std::chrono::steady_clock::duration sliceLength, int hookCount):
+		L(state),
+		slice(sliceLength),
+		granularity(std::max(hookCount, 1)) {};
+
+	Scheduler::~Scheduler() {
+		for (auto& [id, task] : tasks) {
+				luaL_unref(L, LUA_REGISTRYINDEX, task.ref);
+				}
+		};
+
+	Scheduler::TaskId Scheduler::spawn(int nargs, int priority) {
+		// Stack: xxx | func | nargs
+		lua_State* thread = lua_newthread(L);
+		// Stack: xxx | func | nargs | thread
+		lua_insert(L, -(nargs + 2));
+		// Stack: xxx | thread | func | nargs
+
+		if (!lua_checkstack(thread, nargs + 1)) {
+				lua_pop(L, nargs + 2);
+				throw Lua::Error("Too many arguments for task");
+				}
+
+		lua_xmove(L, thread, nargs + 1);
+		// Stack: xxx | thread
+		int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		// Stack: xxx
+
+		auto id = nextId++;
+		auto& task = tasks[id];
+		task.info.id = id;
+		task.info.priority = std::max(priority, 1);
+		task.thread = thread;
+		task.ref = ref;
+		task.pendingArgs = nargs;
+		task.vruntime = ready.empty() ? minVruntime : std::max(minVruntime, ready.begin()->first);
+		ready.emplace(task.vruntime, id);
+		return id;
+		};
+
+	bool Scheduler::runOnce() {
+		if (ready.empty()) return false;
+
+		auto [vruntime, id] = *ready.begin();
+		ready.erase(ready.begin());
+		minVruntime = vruntime;
+
+		// References to map elements survive insertions made by task itself
+		auto& task = tasks.at(id);
+		L.setHook(task.thread, preemptHook, LUA_MASKCOUNT, granularity);
+
+		auto oldRunning = runningScheduler;
+		auto oldCurrent = current;
+		auto oldHook = L.threadHook;
+		auto oldHookCount = L.threadHookCount;
+		runningScheduler = this;
+		current = &task;
+		// Coroutines created before task started get hook once resumed
+		L.threadHook = preemptHook;
+		L.threadHookCount = granularity;
+		preempted = false;
+		task.info.status = Status::RUNNING;
+
+		int nres = 0;
+		int status;
+		auto start = std::chrono::steady_clock::now();
+		sliceEnd = start + slice;
+
+			{
+			StatePtr guard(task.thread); // Make State manage task thread while it runs
+			int nargs = task.pendingArgs;
+			task.pendingArgs = 0;
+			status = lua_resume(task.thread, nullptr, nargs, &nres);
+			}
+
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		bool wasPreempted = preempted;
+		runningScheduler = oldRunning;
+		current = oldCurrent;
+		L.threadHook = oldHook;
+		L.threadHookCount = oldHookCount;
+
+		task.info.cpuTime += elapsed;
+		++task.info.slices;
+		task.vruntime += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / task.info.priority;
+
+		if (status == LUA_YIELD) {
+				if (wasPreempted) ++task.info.preemptions;
+
+				lua_pop(task.thread, nres);
+				task.info.status = Status::READY;
+				ready.emplace(task.vruntime, id);
+				}
+		else if (status == LUA_OK) {
+				lua_pop(task.thread, nres);
+				finish(id, Status::FINISHED);
+				}
+		else {
+				L.clearInterrupt(); // State::interrupt() only stops current task
+				const char* msg = lua_tostring(task.thread, -1);
+				finish(id, Status::FAILED, msg ? msg : "non-string error");
+				}
+
+		return !ready.empty();
+		};
+
+	void Scheduler::run() {
+		while (runOnce()) {}
+		};
+
+	std::size_t Scheduler::runFor(std::chrono::steady_clock::duration budget) {
+		auto deadline = std::chrono::steady_clock::now() + budget;
+		std::size_t count = 0;
+
+		while (!ready.empty() and std::chrono::steady_clock::now() < deadline) {
+				runOnce();
+				++count;
+				}
+
+		return count;
+		};
+
+	bool Scheduler::cancel(TaskId id) {
+		auto it = tasks.find(id);
+
+		if (it == tasks.end() or it->second.info.status == Status::RUNNING) return false;
+
+		ready.erase({it->second.vruntime, id});
+		finish(id, Status::CANCELLED);
+		return true;
+		};
+
+	bool Scheduler::setPriority(TaskId id, int priority) {
+		auto it = tasks.find(id);
+
+		if (it == tasks.end()) return false;
+
+		it->second.info.priority = std::max(priority, 1);
+		return true;
+		};
+
+	std::optional<Scheduler::TaskInfo> Scheduler::getInfo(TaskId id) const {
+		if (auto it = tasks.find(id); it != tasks.end()) {
+				return it->second.info;
+				}
+
+		return std::nullopt;
+		};
+
+	void Scheduler::finish(TaskId id, Status status, std::optional<std::string> error) {
+		auto it = tasks.find(id);
+		auto info = std::move(it->second.info);
+		info.status = status;
+		info.error = std::move(error);
+
+		// Close pending to-be-closed variables
+		if (status != Status::FINISHED) {
+#if LUA_VERSION_RELEASE_NUM >= 50406
+				lua_closethread(it->second.thread, L);
+#else
+				lua_resetthread(it->second.thread);
+#endif
+				}
+
+		luaL_unref(L, LUA_REGISTRYINDEX, it->second.ref);
+		tasks.erase(it);
+
+		if (onComplete) onComplete(info);
+		};
+
+	void Scheduler::preemptHook(lua_State* thread, lua_Debug*) {
+		State::profilerTick(thread);
+		auto self = runningScheduler;
+
+		if (!self or !self->current) return;
+
+		if (std::chrono::steady_clock::now() < self->sliceEnd) return;
+
+		// Inside C function: try again on next hook
+		if (!lua_isyieldable(thread)) return;
+
+		if (thread != self->current->thread) {
+				// Coroutine resumed by task: yield it and let resumers pass yield up to task
+				if (!self->canForwardYield(thread)) return;
+
+				self->L.forwardYield = true;
+				}
+
+		self->preempted = true;
+		lua_yield(thread, 0);
+		};
+
+	bool Scheduler::canForwardYield(lua_State* thread) const {
+		auto running = L.runningThread;
+
+		// Coroutine must be innermost running thread (so not one of other scheduler or resumed by C++ code)
+		if (running->thread != thread) return false;
+
+		// Every resumer up to task thread must be able to yield
+		for (; running and running->resumed; running = running->previous) {
+				if (!running->previous or !lua_isyieldable(running->previous->thread)) return false;
+				}
+
+		return running and running->thread == current->thread;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -1,10 +1,21 @@
 #include "lua++/State.hpp"
 #include "lua++/Error.hpp"
 #include "lua++/CppFunction.hpp"
+#include "lua++/BytecodeCache.hpp"
+#include "lua++/ModuleArchive.hpp"
+#include "lua++/ModuleDirectory.hpp"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "MappedFile.hpp"
 
 static void defaultWarningsHandler(const std::string& warn) {
 	std::cout << "[Lua warning]: " << warn << std::endl;
@@ -12,34 +23,99 @@ static void defaultWarningsHandler(const std::string& warn) {
 
 namespace Lua {
 	namespace {
+		constexpr std::string_view utf8Bom = "\xEF\xBB\xBF";
+
+		/**
+		 * @brief Cut out UTF-8 BOM and first line comment (shebang) as `luaL_loadfile` does.
+		 *
+		 * Newline after comment is kept, so line numbers stay correct (unless binary chunk follows).
+		*/
+		std::string_view skipComment(std::string_view data) {
+			if (data.substr(0, utf8Bom.size()) == utf8Bom) data.remove_prefix(utf8Bom.size());
+
+			if (!data.empty() and data[0] == '#') {
+					auto nl = data.find('\n');
+					data.remove_prefix(nl == std::string_view::npos ? data.size() : nl);
+
+					// Newline is kept to preserve line numbers, but not in front of binary chunk
+					if (data.size() > 1 and data[1] == LUA_SIGNATURE[0]) data.remove_prefix(1);
+					}
+
+			return data;
+			};
+
 		/**
 		 * @brief Helper class for loading from C++ stream.
 		*/
 		class StreamReadHelper {
 			private:
+				static constexpr std::size_t bufferSize = 64 * 1024; ///< Size of internal buffer.
+
 				std::istream& stream;         ///< Source stream.
-				int n = 0;                    ///< Number of pre-read characters.
-				std::array<char, BUFSIZ> buff {}; ///< Internall buffer.
+				bool skip;                    ///< Should first line comment be skipped.
+				std::size_t n = 0;            ///< Number of pre-read characters.
+				std::size_t pos = 0;          ///< Position of first pre-read character not yet passed to %Lua.
+				std::unique_ptr<char[]> buff; ///< Internal buffer.
 
 				/**
-				 * @brief Prepare object to usage
-				 * @warning Currently, it's no-op.
-				 * If required, I can add shebang skipper as in original function.
+				 * @brief Prepare object to usage.
+				 *
+				 * If requested, skip UTF-8 BOM and first line comment. Data read while
+				 * looking for them is kept in buffer.
 				*/
 				void prepare() {
-
+					if (!skip) return;
+
+					stream.read(buff.get(), bufferSize);
+					n = stream.gcount();
+					std::string_view head(buff.get(), n);
+
+					if (head.substr(0, utf8Bom.size()) == utf8Bom) pos = utf8Bom.size();
+
+					if (pos < n and head[pos] == '#') {
+							auto nl = head.find('\n', pos);
+
+							if (nl != std::string_view::npos) {
+									pos = nl;
+
+									// Like in skipComment, drop newline in front of binary chunk
+									if (nl + 1 < n ? head[nl + 1] == LUA_SIGNATURE[0] : stream.peek() == LUA_SIGNATURE[0]) ++pos;
+									}
+							else {
+									// Comment is longer than buffer
+									pos = n;
+									stream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+									if (!stream.eof() and stream.peek() != LUA_SIGNATURE[0]) {
+											buff[0] = '\n';
+											pos = 0;
+											n = 1;
+											}
+									}
+							}
 					};
 			public:
-				StreamReadHelper(std::istream& s): stream(s) { prepare(); }; ///< Main constructor
+				/// Main constructor
+				StreamReadHelper(std::istream& s, bool skipFirstLine = false):
+					stream(s),
+					skip(skipFirstLine),
+					buff(new char[bufferSize]) { prepare(); };
 				/**
 				 * @brief Read data from stream in %Lua style.
 				**/
 				const char* luaRead(size_t* size) {
+					if (pos < n) {
+							const char* res = buff.get() + pos;
+							*size = n - pos;
+							pos = n;
+							return res;
+							}
+
 					if (!stream.good()) return nullptr;
 
-					stream.read(buff.data(), BUFSIZ);
+					stream.read(buff.get(), bufferSize);
 					*size = stream.gcount();
-					return buff.data();
+					return buff.get();
 					};
 				/**
 				 * @brief Forward raw call to C++ object.
@@ -81,7 +157,7 @@ namespace Lua {
 			// Base
 				{DefaultLibs::BASE,      {LUA_GNAME, luaopen_base}},
 			// Safe
-				{DefaultLibs::COROUTINE, {LUA_COLIBNAME, luaopen_coroutine}},
+				{DefaultLibs::COROUTINE, {LUA_COLIBNAME, State::openCoroutineLib}},
 				{DefaultLibs::TABLE,     {LUA_TABLIBNAME, luaopen_table}},
 				{DefaultLibs::STRING,    {LUA_STRLIBNAME, luaopen_string}},
 				{DefaultLibs::MATH,      {LUA_MATHLIBNAME, luaopen_math}},
@@ -100,6 +176,115 @@ namespace Lua {
 				{LoadMode::BOTH,   "bt"}
 			};
 
+		/// Registry key of table with lazily loaded libraries.
+		const char lazyLibsKey = 0;
+
+		/// Can library be loaded with State::loadDefaultLibLazy.
+		bool canBeLazy(DefaultLibs libid) {
+			return libid != DefaultLibs::BASE and libid != DefaultLibs::STRING and libid != DefaultLibs::PACKAGE;
+			};
+
+		/// `__index` of `_G`: open library on first access (upvalue: table of `luaopen_*` functions).
+		int lazyLibsIndex(lua_State* L) {
+			// Stack: _G, key
+			if (lua_type(L, 2) != LUA_TSTRING) return 0;
+
+			lua_pushvalue(L, 2);
+
+			if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TFUNCTION) return 0;
+
+			// Stack: _G, key, luaopen_*
+			// Reuses package.loaded entry if library was already required
+			luaL_requiref(L, lua_tostring(L, 2), lua_tocfunction(L, -1), 0);
+			// Stack: _G, key, luaopen_*, library
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, 1);
+			return 1;
+			};
+
+		const Key packageKey(LUA_LOADLIBNAME);
+		const Key preloadKey("preload");
+		const Key searchersKey("searchers");
+
+		/// Push shallow copy of table at given index.
+		void copyTable(lua_State* L, int idx) {
+			// Stack: xxx
+			idx = lua_absindex(L, idx);
+			luaL_checkstack(L, 3, nullptr);
+			lua_createtable(L, 0, 0);
+			lua_pushnil(L);
+
+			// Stack: xxx, copy, key
+			while (lua_next(L, idx)) {
+					// Stack: xxx, copy, key, value
+					lua_pushvalue(L, -2);
+					lua_insert(L, -2);
+					// Stack: xxx, copy, key, key, value
+					lua_rawset(L, -4);
+					// Stack: xxx, copy, key
+					}
+
+			// Stack: xxx, copy
+			};
+
+		/// Make table at `target` shallow-equal to one at `snapshot`.
+		void restoreTable(lua_State* L, int target, int snapshot) {
+			// Stack: xxx
+			target = lua_absindex(L, target);
+			snapshot = lua_absindex(L, snapshot);
+			luaL_checkstack(L, 4, nullptr);
+
+			// Pass 1: remove new fields and restore changed ones (only existing fields are touched)
+			lua_pushnil(L);
+
+			// Stack: xxx, key
+			while (lua_next(L, target)) {
+					// Stack: xxx, key, value
+					lua_pushvalue(L, -2);
+					lua_rawget(L, snapshot);
+
+					// Stack: xxx, key, value, old value
+					if (!lua_rawequal(L, -1, -2)) {
+							lua_pushvalue(L, -3);
+							lua_insert(L, -2);
+							// Stack: xxx, key, value, key, old value
+							lua_rawset(L, target);
+							}
+					else {
+							lua_pop(L, 1);
+							}
+
+					// Stack: xxx, key, value
+					lua_pop(L, 1);
+					}
+
+			// Pass 2: bring back removed fields
+			lua_pushnil(L);
+
+			// Stack: xxx, key
+			while (lua_next(L, snapshot)) {
+					// Stack: xxx, key, old value
+					lua_pushvalue(L, -2);
+
+					// Stack: xxx, key, old value, key
+					if (lua_rawget(L, target) == LUA_TNIL) {
+							lua_pop(L, 1);
+							lua_pushvalue(L, -2);
+							lua_insert(L, -2);
+							// Stack: xxx, key, key, old value
+							lua_rawset(L, target);
+							}
+					else {
+							lua_pop(L, 2);
+							}
+
+					// Stack: xxx, key
+					}
+
+			// Stack: xxx
+			};
+
 		int luaPanic(lua_State* L) {
 			std::cerr << "Lua panic (unprotected call): " << lua_tostring(L, -1) << std::endl;
 			return 0;
@@ -153,7 +338,7 @@ namespace Lua {
 				}
 		};
 
-	State::State(DefaultLibsPreset openlibs, lua_Alloc alloc, void* ud) {
+	State::State(DefaultLibsPreset openlibs, lua_Alloc alloc, void* ud, bool lazyLibs) {
 		if (!alloc) {
 				alloc = luaAlloc;
 				}
@@ -163,6 +348,8 @@ namespace Lua {
 		if (!mainState) throw Lua::Error("Can't create state");
 
 		lua_atpanic(mainState, &luaPanic);
+		mainThread.thread = mainState;
+		publishedThread = mainState;
 
 		luaStatePtr = new State*(this);
 		static_assert(sizeof(State***) <= LUA_EXTRASPACE);
@@ -175,12 +362,18 @@ namespace Lua {
 		if (openlibs != DefaultLibsPreset::NONE) {
 				loadDefaultLib(DefaultLibs::BASE);
 				registerStandardTypes();
+				// Deferred libraries are registered after `package`, so `require` can find them
+				std::vector<DefaultLibs> deferred;
+				auto open = [this, lazyLibs, &deferred](DefaultLibs libid) {
+					if (lazyLibs and canBeLazy(libid)) deferred.push_back(libid);
+					else loadDefaultLib(libid);
+					};
 
 				switch (openlibs) {
 					case DefaultLibsPreset::ALL:
-						loadDefaultLib(DefaultLibs::IO);
-						loadDefaultLib(DefaultLibs::OS);
-						loadDefaultLib(DefaultLibs::DEBUG);
+						open(DefaultLibs::IO);
+						open(DefaultLibs::OS);
+						open(DefaultLibs::DEBUG);
 
 						[[fallthrough]];
 
@@ -188,16 +381,16 @@ namespace Lua {
 						[[fallthrough]];
 
 					case DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE:
-						loadDefaultLib(DefaultLibs::PACKAGE);
+						open(DefaultLibs::PACKAGE);
 
 						[[fallthrough]];
 
 					case DefaultLibsPreset::SAFE:
-						loadDefaultLib(DefaultLibs::COROUTINE);
-						loadDefaultLib(DefaultLibs::TABLE);
-						loadDefaultLib(DefaultLibs::STRING);
-						loadDefaultLib(DefaultLibs::MATH);
-						loadDefaultLib(DefaultLibs::UTF8);
+						open(DefaultLibs::COROUTINE);
+						open(DefaultLibs::TABLE);
+						open(DefaultLibs::STRING);
+						open(DefaultLibs::MATH);
+						open(DefaultLibs::UTF8);
 
 						[[fallthrough]];
 
@@ -210,17 +403,26 @@ namespace Lua {
 						;
 						}
 
+				for (auto libid : deferred) {
+						loadDefaultLibLazy(libid);
+						}
+
 				if (openlibs == DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE)
 					stripPackageLibrary();
 				}
 		};
 
+	State::State(DefaultLibsPreset openlibs, std::unique_ptr<Allocator> alloc, bool lazyLibs):
+		State(openlibs, alloc ? Allocator::luaAlloc : nullptr, alloc.get(), lazyLibs) {
+		allocator = std::move(alloc);
+		};
+
 	bool State::loadPackageTables() {
 		luaL_checkstack(state, 2, nullptr);
 		// Stack: xxx
 		luaL_getsubtable(state, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
 		// Stack: xxx, package.loaded
-		lua_getfield(state, -1, luaLibs.at(DefaultLibs::PACKAGE).name);
+		getField(-1, packageKey);
 
 		// Stack: xxx, package.loaded, package
 		if (!lua_toboolean(state, -1)) {
@@ -251,7 +453,7 @@ namespace Lua {
 		removeField("searchpath"); // Allow scanning filesystem
 
 		// Stack: xxx, package.loaded, package
-		lua_getfield(state, -1, "searchers");
+		getField(-1, searchersKey);
 
 		// Stack: xxx, package.loaded, package, package.searchers
 		if (lua_toboolean(state, -1)) {
@@ -295,13 +497,79 @@ namespace Lua {
 					}
 			};
 
+		return appendSearcher(LuaSide);
+		};
+
+	bool State::addArchive(std::shared_ptr<const ModuleArchive> archive, LoadMode mode) {
+		CppFunction searcher = [archive, mode](StatePtr & Lp) -> int {
+			// Stack: function object, module name
+			std::size_t len = 0;
+			const char* str = lua_tolstring(**Lp, 2, &len);
+
+			if (!str) return 0;
+
+			std::string name(str, len);
+			auto chunk = archive->find(name);
+
+			if (!chunk) {
+					lua_pushfstring(**Lp, "no module '%s' in archive '%s'", str, archive->getFilename().c_str());
+					return 1;
+					}
+
+			try {
+					Lp->loadBuffer(*chunk, "=" + name, mode);
+					}
+			catch (const SyntaxError& e) {
+					luaL_error(**Lp, "error loading module '%s' from archive '%s':\n\t%s", str, archive->getFilename().c_str(), e.what());
+					}
+
+			// Stack: function object, module name, chunk
+			lua_pushstring(**Lp, archive->getFilename().c_str());
+			// Stack: function object, module name, chunk, archive name (loader data)
+			return 2;
+			};
+
+		return appendSearcher(searcher);
+		};
+
+	bool State::addDirectory(std::shared_ptr<ModuleDirectory> dir, LoadMode mode) {
+		CppFunction searcher = [dir, mode](StatePtr & Lp) -> int {
+			// Stack: function object, module name
+			std::size_t len = 0;
+			const char* str = lua_tolstring(**Lp, 2, &len);
+
+			if (!str) return 0;
+
+			auto path = dir->find(std::string_view(str, len));
+
+			if (!path) {
+					lua_pushfstring(**Lp, "no module '%s' in directory '%s'", str, dir->getRoot().c_str());
+					return 1;
+					}
+
+			try {
+					Lp->loadFile(*path, mode);
+					}
+			catch (const SyntaxError& e) {
+					luaL_error(**Lp, "error loading module '%s' from file '%s':\n\t%s", str, path->c_str(), e.what());
+					}
+
+			// Stack: function object, module name, chunk
+			lua_pushlstring(**Lp, path->data(), path->size());
+			// Stack: function object, module name, chunk, file name (loader data)
+			return 2;
+			};
+
+		return appendSearcher(searcher);
+		};
 
+	bool State::appendSearcher(const CppFunction& searcher) {
 		// Stack: xxx
 		if (!loadPackageTables()) return false;
 
 		// Stack: xxx, package.loaded, package
 		luaL_checkstack(state, 2, nullptr);
-		lua_getfield(state, -1, "searchers");
+		getField(-1, searchersKey);
 		// Stack: xxx, package.loaded, package, package.searchers
 
 		if (!lua_toboolean(state, -1)) {
@@ -310,7 +578,7 @@ namespace Lua {
 				}
 
 		// Stack: xxx, package.loaded, package, package.searchers
-		pushOne(LuaSide);
+		pushOne(searcher);
 		// Stack: xxx, package.loaded, package, package.searchers, our searcher
 		lua_rawseti(state, -2, luaL_len(state, -2)+1);
 		// Stack: xxx, package.loaded, package, package.searchers
@@ -324,7 +592,7 @@ namespace Lua {
 
 		// Stack: xxx, package.loaded, package
 		luaL_checkstack(state, 1, nullptr);
-		lua_getfield(state, -1, "preload");
+		getField(-1, preloadKey);
 		// Stack: xxx, package.loaded, package, package.preload
 
 		if (!lua_toboolean(state, -1)) {
@@ -347,7 +615,7 @@ namespace Lua {
 
 		// Stack: xxx, package.loaded, package
 		luaL_checkstack(state, 1, nullptr);
-		lua_getfield(state, -1, "preload");
+		getField(-1, preloadKey);
 		// Stack: xxx, package.loaded, package, package.preload
 
 		if (!lua_toboolean(state, -1)) {
@@ -366,6 +634,117 @@ namespace Lua {
 		return true;
 		};
 
+	bool State::addPreloadedChunk(const std::string& name, std::string_view chunk, LoadMode mode) {
+		auto chunkName = "=" + name;
+		CppFunction loader = [chunk, chunkName, mode](StatePtr & Lp) -> int {
+			// Stack: function object, module name, loader data
+			auto nargs = lua_gettop(**Lp) - 1;
+			Lp->loadBuffer(chunk, chunkName, mode);
+			// Stack: function object, module name, loader data, chunk
+			lua_insert(**Lp, 2);
+			// Stack: function object, chunk, module name, loader data
+			lua_call(**Lp, nargs, LUA_MULTRET);
+			return lua_gettop(**Lp) - 1;
+			};
+		return addPreloaded(name, loader);
+		};
+
+	void State::internKey(const Key& key) {
+		auto id = key.getId();
+
+		if (id >= keySlots.size()) {
+				keySlots.resize(id + 1, LUA_NOREF);
+				}
+
+		luaL_checkstack(state, 2, nullptr);
+		auto name = key.getName();
+		lua_pushlstring(state, name.data(), name.size());
+		lua_pushvalue(state, -1);
+		keySlots[id] = luaL_ref(state, LUA_REGISTRYINDEX);
+		};
+
+	int State::pushPath(int idx, const Path& path) {
+		// Stack: xxx
+		luaL_checkstack(state, 2, nullptr);
+		lua_pushvalue(state, idx);
+		auto type = lua_type(state, -1);
+
+		// Stack: xxx, current table
+		for (const auto& key : path.getKeys()) {
+				if (type != LUA_TTABLE) {
+						// Miss
+						pop(1);
+						lua_pushnil(state);
+						return LUA_TNIL;
+						}
+
+				type = getField(-1, key);
+				// Stack: xxx, current table, next value
+				lua_remove(state, -2);
+				// Stack: xxx, next value
+				}
+
+		// Stack: xxx, result
+		return type;
+		};
+
+	void State::saveBaseline() {
+		// Stack: xxx
+		luaL_checkstack(state, 3, nullptr);
+		lua_createtable(state, 2, 0);
+		// Stack: xxx, baseline
+		lua_pushglobaltable(state);
+		copyTable(state, -1);
+		lua_rawseti(state, -3, 1);
+		pop(1);
+		// Stack: xxx, baseline
+		luaL_getsubtable(state, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+		copyTable(state, -1);
+		lua_rawseti(state, -3, 2);
+		pop(1);
+
+		// Stack: xxx, baseline
+		if (baselineRef == LUA_NOREF) {
+				baselineRef = luaL_ref(state, LUA_REGISTRYINDEX);
+				}
+		else {
+				lua_rawseti(state, LUA_REGISTRYINDEX, baselineRef);
+				}
+
+		// Stack: xxx
+		};
+
+	bool State::resetToBaseline(bool gcStep) {
+		// Reset to main thread and clear stack
+		state = mainState;
+		clearInterrupt();
+		lua_settop(state, 0);
+		warnBuf.str("");
+
+		if (baselineRef == LUA_NOREF) return false;
+
+		// Stack: (empty)
+		luaL_checkstack(state, 3, nullptr);
+		lua_rawgeti(state, LUA_REGISTRYINDEX, baselineRef);
+		// Stack: baseline
+		lua_pushglobaltable(state);
+		lua_rawgeti(state, 1, 1);
+		restoreTable(state, 2, 3);
+		lua_settop(state, 1);
+		// Stack: baseline
+		luaL_getsubtable(state, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+		lua_rawgeti(state, 1, 2);
+		restoreTable(state, 2, 3);
+		lua_settop(state, 0);
+
+		// Stack: (empty)
+		if (gcStep) {
+				lua_gc(state, LUA_GCSTEP, 0);
+				}
+
+		return true;
+		};
+
 	State::~State() {
 		if (mainState) {
 				lua_close(mainState);
@@ -376,6 +755,15 @@ namespace Lua {
 	int State::pcall(int nargs, std::optional<int> nres) {
 		// Stack: xxx + function + nargs
 		int oldStacktop = lua_gettop(state);
+		// Only outermost call reports interruption, nested one (made by binding) lets hook keep raising error
+		bool outermost = pcallDepth == 0 and runningThread == &mainThread;
+
+		struct DepthGuard {
+			int& depth;
+
+			~DepthGuard() { --depth; };
+			} depthGuard {++pcallDepth};
+
 		auto res = lua_pcall(state, nargs, nres.value_or(LUA_MULTRET), 0);
 
 		if (res == LUA_OK)     {
@@ -384,16 +772,363 @@ namespace Lua {
 				}
 		else if (res == LUA_ERRRUN) {
 				// Stack: xxx + errmsg
+				if (outermost and clearInterrupt()) {
+						pop(1);
+						throw InterruptedError("Lua execution interrupted");
+						}
+
 				throwLuaError();
 				}
 		else if (res == LUA_ERRMEM) {
-				throw std::bad_alloc(); // Uh-oh
+				throwMemoryError(); // Uh-oh
 				}
 		else                        {
 				std::abort();
 				}
 		};
 
+	int State::pcall(int nargs, std::optional<int> nres, const CallBudget& budget) {
+		ActiveBudget active {budget};
+
+		// Restores previous hook (and budget) on any exit, so limited calls can be nested
+		struct HookGuard {
+			State& L;
+			lua_State* thread;
+			ActiveBudget* oldBudget;
+			SavedHook oldHook;
+
+			~HookGuard() {
+				L.setHook(thread, oldHook.hook, oldHook.mask, oldHook.count);
+				L.activeBudget = oldBudget;
+				};
+			} guard {*this, state, activeBudget, getHook(state)};
+
+		activeBudget = &active;
+		active.count = std::max(budget.granularity, 1);
+
+		if (budget.instructions != 0 and budget.instructions < static_cast<std::size_t>(active.count)) {
+				active.count = static_cast<int>(budget.instructions);
+				}
+
+		setHook(state, budgetHook, LUA_MASKCOUNT, active.count);
+
+		try {
+				return pcall(nargs, nres);
+				}
+		catch (const StateError&) {
+				if (active.exhausted) throw TimeoutError("Lua execution budget exceeded");
+
+				throw;
+				}
+		};
+
+	void State::budgetHook(lua_State* L, lua_Debug*) {
+		profilerTick(L);
+		auto self = getFromLuaState(L);
+		auto budget = self->activeBudget;
+
+		if (!budget) return;
+
+		if (!budget->exhausted) {
+				const auto& limits = budget->limits;
+				budget->used += static_cast<std::size_t>(lua_gethookcount(L));
+
+				if ((limits.instructions == 0 or budget->used < limits.instructions) and
+						(!limits.deadline or std::chrono::steady_clock::now() < *limits.deadline)) {
+						return;
+						}
+
+				budget->exhausted = true;
+				}
+
+		// Fail on every instruction from now on, in case script catches error
+		self->setHook(L, budgetHook, LUA_MASKCOUNT, 1);
+		luaL_error(L, "execution budget exceeded");
+		};
+
+	void State::interrupt() {
+		interruptPending = true;
+		++interruptsInProgress;
+
+		// Threads it was entered from are hooked by leaveThread()
+		if (auto L = publishedThread.load()) hookInterrupt(L);
+
+		--interruptsInProgress;
+		};
+
+	bool State::clearInterrupt() {
+		interruptPending = false;
+		waitForInterrupts();
+
+		// Innermost entry of thread listed twice is restored first, so other one is skipped
+		for (auto entry = runningThread; entry; entry = entry->previous) {
+				if (lua_gethook(entry->thread) == interruptHook) entry->hook.restore(entry->thread);
+				}
+
+		return std::exchange(interruptRaised, false);
+		};
+
+	void State::hookInterrupt(lua_State* L) noexcept {
+		// Same mask as standalone interpreter uses for SIGINT
+		constexpr int mask = LUA_MASKCALL | LUA_MASKRET | LUA_MASKLINE | LUA_MASKCOUNT;
+		lua_sethook(L, interruptHook, mask, 1);
+		};
+
+	void State::interruptHook(lua_State* L, lua_Debug*) {
+		auto self = getFromLuaState(L);
+
+		// Coroutine created while interrupted may have inherited hook
+		if (!self->interruptPending) return;
+
+		self->interruptRaised = true;
+		luaL_error(L, "interrupted");
+		};
+
+	void State::publishThread(lua_State* L) noexcept {
+		// Pairs with interrupt(): either it sees this thread or this sees flag
+		publishedThread = L;
+
+		if (interruptPending) hookInterrupt(L);
+		};
+
+	void State::waitForInterrupts() const noexcept {
+		// Never waits when interrupt() is called by signal handler: it returns before this thread goes on
+		while (interruptsInProgress != 0) std::this_thread::yield();
+		};
+
+	void State::setHook(lua_State* L, lua_Hook hook, int mask, int count) noexcept {
+		bool isRunning = false;
+
+		for (auto entry = runningThread; entry; entry = entry->previous) {
+				if (entry->thread == L) {
+						entry->hook = {hook, mask, count};
+						isRunning = true;
+						break;
+						}
+				}
+
+		lua_sethook(L, hook, mask, count);
+		// Pairs with interrupt(): don't overwrite hook it has just installed
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (isRunning and interruptPending) hookInterrupt(L);
+		};
+
+	State::SavedHook State::getHook(lua_State* L) const noexcept {
+		for (auto entry = runningThread; entry; entry = entry->previous) {
+				if (entry->thread == L) return entry->hook;
+				}
+
+		auto res = SavedHook::of(L);
+
+		// Inherited by coroutine created while interrupted
+		if (res.hook == interruptHook) res = {};
+
+		return res;
+		};
+
+	void State::enterThread(RunningThread& running, lua_State* L, bool resumed) noexcept {
+		running.thread = L;
+		running.resumed = resumed;
+		running.previous = runningThread;
+		running.entered = getHook(L);
+		running.hook = running.entered;
+
+		if (activeBudget) {
+				// Coroutine may come from before limited call (or previous one): make it count too
+				running.hook = {budgetHook, LUA_MASKCOUNT, activeBudget->count};
+				}
+		else if (threadHook and running.hook.hook != threadHook) {
+				running.hook = {threadHook, LUA_MASKCOUNT, threadHookCount};
+				}
+
+		if (SavedHook::of(L) != running.hook) running.hook.restore(L);
+
+		runningThread = &running;
+		publishThread(L);
+		};
+
+	void State::leaveThread(RunningThread& running) noexcept {
+		runningThread = running.previous;
+		publishThread(runningThread->thread);
+		waitForInterrupts();
+
+		if (running.thread == runningThread->thread) {
+				// Still running (entered twice)
+				setHook(running.thread, runningThread->hook.hook, runningThread->hook.mask, runningThread->hook.count);
+				}
+		else if (SavedHook::of(running.thread) != running.entered) {
+				running.entered.restore(running.thread);
+				}
+		};
+
+	State::ThreadScope::ThreadScope(State& state, lua_State* L, bool resumed): L(state) {
+		if (L) this->L.enterThread(running, L, resumed);
+		};
+
+	State::ThreadScope::~ThreadScope() {
+		if (running.thread) L.leaveThread(running);
+		};
+
+	int State::openCoroutineLib(lua_State* L) {
+		luaopen_coroutine(L);
+		// Stack: coroutine
+		luaL_checkstack(L, 2, nullptr);
+		lua_getfield(L, -1, "resume");
+		lua_pushcclosure(L, resumeWrapper, 1);
+		lua_setfield(L, -2, "resume");
+		lua_getfield(L, -1, "wrap");
+		lua_pushcclosure(L, wrapWrapper, 1);
+		lua_setfield(L, -2, "wrap");
+		return 1;
+		};
+
+	int State::resumeWrapper(lua_State* L) {
+		// Stack: co, args
+		luaL_checkstack(L, 2, nullptr);
+
+		if (lua_gettop(L) == 0) lua_pushnil(L); // Let original function report it
+
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_insert(L, 1);
+		// Stack: resume, co, args
+		return resumeTracked(L, LUA_OK, 1);
+		};
+
+	int State::wrapWrapper(lua_State* L) {
+		// Stack: func
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_insert(L, 1);
+		lua_call(L, lua_gettop(L) - 1, 1);
+		// Stack: wrapped
+		lua_pushcclosure(L, wrappedCall, 1);
+		return 1;
+		};
+
+	int State::wrappedCall(lua_State* L) {
+		// Stack: args
+		luaL_checkstack(L, 3, nullptr);
+		lua_pushvalue(L, lua_upvalueindex(1));
+		// Coroutine is the only upvalue of function made by `coroutine.wrap`
+		if (!lua_getupvalue(L, -1, 1)) {
+				lua_pushnil(L);
+				}
+		else if (!lua_isthread(L, -1)) {
+				lua_pop(L, 1);
+				lua_pushnil(L);
+				}
+
+		lua_rotate(L, 1, 2);
+		// Stack: wrapped, co, args
+		return resumeTracked(L, LUA_OK, 0);
+		};
+
+	int State::resumeTracked(lua_State* L, int status, lua_KContext passThread) {
+		// Stack: function, co, args
+		auto self = getFromLuaState(L);
+		lua_State* co = lua_tothread(L, 2);
+
+		// Resumed after forwarded yield: continue coroutine where it was stopped
+		if (status == LUA_YIELD) lua_settop(L, 2);
+
+		while (true) {
+				int nargs = lua_gettop(L) - 2;
+				luaL_checkstack(L, 2, nullptr);
+				lua_pushvalue(L, 1);
+				lua_insert(L, 3);
+
+				if (passThread) {
+						lua_pushvalue(L, 2);
+						lua_insert(L, 4);
+						++nargs;
+						}
+
+					{
+					ThreadScope scope(*self, co, true);
+					self->forwardYield = false;
+					// Original function never yields: continuation is only given to keep this thread yieldable
+					lua_callk(L, nargs, LUA_MULTRET, passThread, resumeTracked);
+					}
+
+				// Stack: function, co, results
+				if (!self->forwardYield) return lua_gettop(L) - 2;
+
+				// Coroutine was preempted by Scheduler: pass yield up to task (its results are dropped)
+				if (lua_isyieldable(L)) return lua_yieldk(L, 0, passThread, resumeTracked);
+
+				self->forwardYield = false;
+				lua_settop(L, 2);
+				}
+		};
+
+	void State::startProfiler(std::chrono::steady_clock::duration interval, int granularity) {
+		if (!profiler) profiler = std::make_unique<Profiler>(interval);
+		else profiler->setInterval(interval);
+
+		profiling = true;
+
+		for (auto L : {mainState, state}) {
+				// Don't replace other hooks
+				if (!getHook(L).hook) setHook(L, profilerHook, LUA_MASKCOUNT, std::max(granularity, 1));
+				}
+		};
+
+	void State::stopProfiler() {
+		profiling = false; // Hooks inherited by coroutines become no-op
+
+		for (auto L : {mainState, state}) {
+				if (getHook(L).hook == profilerHook) setHook(L, nullptr, 0, 0);
+				}
+		};
+
+	void State::resetProfiler() noexcept {
+		if (profiler) profiler->reset();
+		};
+
+	void State::profilerHook(lua_State* L, lua_Debug*) {
+		profilerTick(L);
+		};
+
+	void State::profilerTick(lua_State* L) {
+		auto self = getFromLuaState(L);
+
+		if (self->profiling and self->profiler->due()) self->profiler->sample(L);
+		};
+
+	void State::enableCallStats(bool enable) {
+		if (enable and !callStats) callStats = std::make_unique<CallStats>();
+
+		callStatsEnabled = enable;
+		};
+
+	void State::throwMemoryError() {
+		if (auto accounting = dynamic_cast<AccountingAllocator*>(allocator.get()); accounting and accounting->consumeLimitHit()) {
+				pop(1); // Error message
+				throw MemoryLimitError("Lua memory limit of " + std::to_string(accounting->getStats().limit) + " bytes exceeded");
+				}
+
+		throw std::bad_alloc();
+		};
+
+	MemoryStats State::memoryStats() const {
+		if (auto accounting = dynamic_cast<const AccountingAllocator*>(allocator.get())) {
+				return accounting->getStats();
+				}
+
+		MemoryStats res;
+		res.current = gc().count();
+		return res;
+		};
+
+	bool State::setMemoryLimit(std::size_t limit) {
+		if (auto accounting = dynamic_cast<AccountingAllocator*>(allocator.get())) {
+				accounting->setLimit(limit);
+				return true;
+				}
+
+		return false;
+		};
+
 	template<typename T>
 	void State::loadInternal(T& reader, const std::string& name, LoadMode mode) {
 		auto res = lua_load(state, T::luaReadStatic, &reader, name.c_str(), luaLoadModes.at(mode));
@@ -406,7 +1141,7 @@ namespace Lua {
 				throw SyntaxError(err.value());
 				}
 		else if (res == LUA_ERRMEM) {
-				throw std::bad_alloc();
+				throwMemoryError();
 				}
 		else std::abort(); // I hope you have your towel ready, things are going really messy around there…
 		};
@@ -416,14 +1151,81 @@ namespace Lua {
 		loadInternal(reader, name, mode);
 		};
 
-	void State::load(const std::string& str, LoadMode mode) {
-		StringReadHelper reader(str);
-		loadInternal(reader, str, mode);
+	void State::loadBuffer(std::string_view data, const std::string& name, LoadMode mode) {
+		bool isBinary = !data.empty() and data[0] == LUA_SIGNATURE[0];
+
+		if (!bytecodeCache or mode == LoadMode::BINARY or isBinary) {
+				StringReadHelper reader(data);
+				loadInternal(reader, name, mode);
+				return;
+				}
+
+		auto key = BytecodeCache::hash(data, name);
+
+		if (auto chunk = bytecodeCache->find(key)) {
+				// We produced this chunk ourselves, so binary mode is fine here
+				StringReadHelper reader(*chunk);
+
+				try {
+						loadInternal(reader, name, LoadMode::BINARY);
+						return;
+						}
+				catch (const SyntaxError&) {
+						// Corrupted or built by incompatible Lua: drop it and recompile
+						pop(1);
+						bytecodeCache->erase(key);
+						}
+				}
+
+		StringReadHelper reader(data);
+		loadInternal(reader, name, mode);
+		bytecodeCache->store(key, dump(bytecodeCache->getStrip()));
+		};
+
+	void State::load(std::string_view code, std::string_view name, LoadMode mode) {
+		// Name must be null-terminated for Lua
+		loadBuffer(code, std::string(name), mode);
 		};
 
 	void State::loadFile(const std::string& filename, LoadMode mode) {
-		std::ifstream fin(filename);
-		load(fin, "@" + filename, mode);
+		const auto chunkName = "@" + filename;
+#ifdef LUAPP_HAVE_MMAP
+			{
+			// Whole file goes to Lua (and bytecode cache) in one piece, without copying
+			MappedFile file(filename);
+
+			if (file.valid()) {
+					loadBuffer(skipComment(file.view()), chunkName, mode);
+					return;
+					}
+			}
+#endif
+		// Pipes, devices, empty or missing files
+		std::ifstream fin(filename, std::ios::binary);
+
+		if (bytecodeCache) {
+				// Need whole source to compute key
+				std::string source(std::istreambuf_iterator<char>(fin), {});
+				loadBuffer(skipComment(source), chunkName, mode);
+				return;
+				}
+
+		StreamReadHelper reader(fin, true);
+		loadInternal(reader, chunkName, mode);
+		};
+
+	std::string State::dump(bool strip) {
+		std::string res;
+		auto writer = []([[maybe_unused]] lua_State * L, const void* p, size_t sz, void* ud) -> int {
+			static_cast<std::string*>(ud)->append(static_cast<const char*>(p), sz);
+			return 0;
+			};
+
+		if (lua_type(state, -1) != LUA_TFUNCTION or lua_dump(state, writer, &res, strip) != 0) {
+				throw Lua::Error("Can't dump value on top of stack");
+				}
+
+		return res;
 		};
 
 	void State::loadDefaultLib(DefaultLibs libid) {
@@ -432,6 +1234,50 @@ namespace Lua {
 		pop(1);  /* remove lib */
 		};
 
+	void State::loadDefaultLibLazy(DefaultLibs libid) {
+		if (!canBeLazy(libid)) {
+				loadDefaultLib(libid);
+				return;
+				}
+
+		const auto& lib = luaLibs.at(libid); // Must never fail
+		luaL_checkstack(state, 4, nullptr);
+
+		// Stack: xxx
+		if (lua_rawgetp(state, LUA_REGISTRYINDEX, &lazyLibsKey) != LUA_TTABLE) {
+				// First lazy library: create table and hook it into _G
+				pop(1);
+				lua_createtable(state, 0, 8);
+				lua_pushvalue(state, -1);
+				lua_rawsetp(state, LUA_REGISTRYINDEX, &lazyLibsKey);
+				// Stack: xxx, lazy libs
+				lua_pushglobaltable(state);
+
+				if (!lua_getmetatable(state, -1)) lua_createtable(state, 0, 1);
+
+				// Stack: xxx, lazy libs, _G, metatable
+				lua_pushvalue(state, -3);
+				lua_pushcclosure(state, lazyLibsIndex, 1);
+				lua_setfield(state, -2, "__index");
+				lua_setmetatable(state, -2);
+				pop(1);
+				}
+
+		// Stack: xxx, lazy libs
+		lua_pushcfunction(state, lib.func);
+		lua_setfield(state, -2, lib.name);
+		pop(1);
+
+		// Stack: xxx
+		if (lua_getfield(state, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE) == LUA_TTABLE) {
+				// Stack: xxx, package.preload
+				lua_pushcfunction(state, lib.func);
+				lua_setfield(state, -2, lib.name);
+				}
+
+		pop(1);
+		};
+
 	void State::setWarningFunction(const std::function<void(const std::string&)>& func) {
 		warnFunc = func;
 		};
@@ -485,6 +1331,9 @@ namespace Lua {
 		ptr = State::getFromLuaState(L);
 
 		if (ptr->state != L) {
+				// Coroutine resumed from Lua is already running (common case of binding called there)
+				if (ptr->runningThread->thread != L) ptr->enterThread(running, L, false);
+
 				oldState = ptr->state;
 				ptr->state = L;
 				}
@@ -496,6 +1345,8 @@ namespace Lua {
 
 	StatePtr::~StatePtr() {
 		if (oldState) {
+				if (running.thread) ptr->leaveThread(running);
+
 				ptr->state = oldState;
 				}
 		}
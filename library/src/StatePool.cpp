@@ -0,0 +1,114 @@
+#include "lua++/StatePool.hpp"
+#include "lua++/Error.hpp"
+
+namespace Lua {
+	StatePool::Handle& StatePool::Handle::operator=(Handle&& old) noexcept {
+		if (this != &old) {
+				release();
+				pool = old.pool;
+				ptr = std::move(old.ptr);
+				}
+
+		return *this;
+		};
+
+	StatePool::Handle::~Handle() {
+		release();
+		};
+
+	void StatePool::Handle::release() {
+		if (ptr) {
+				pool->release(std::move(ptr));
+				}
+		};
+
+	StatePool::StatePool(Factory f, std::size_t prewarmCount, std::size_t maxIdleCount, bool gc):
+		factory(std::move(f)),
+		maxIdle(maxIdleCount),
+		gcOnRelease(gc) {
+		prewarm(prewarmCount);
+		};
+
+	std::unique_ptr<State> StatePool::create() {
+		auto L = factory();
+
+		if (!L) throw Lua::Error("State pool factory returned nothing");
+
+		L->saveBaseline();
+		std::lock_guard lock(mutex);
+		++stats.created;
+		return L;
+		};
+
+	StatePool::Handle StatePool::acquire() {
+			{
+			std::lock_guard lock(mutex);
+			++stats.acquired;
+			++stats.inUse;
+
+			if (stats.inUse > stats.highWater) stats.highWater = stats.inUse;
+
+			if (!idle.empty()) {
+					auto L = std::move(idle.back());
+					idle.pop_back();
+					++stats.reused;
+					return Handle(this, std::move(L));
+					}
+			}
+
+		try {
+				return Handle(this, create());
+				}
+		catch (...) {
+				std::lock_guard lock(mutex);
+				--stats.inUse;
+				throw;
+				}
+		};
+
+	void StatePool::release(std::unique_ptr<State> L) {
+		// Reset outside of lock: it may take a while
+		L->resetToBaseline(gcOnRelease);
+
+		std::lock_guard lock(mutex);
+		--stats.inUse;
+
+		if (idle.size() < maxIdle) {
+				idle.push_back(std::move(L));
+				}
+		else {
+				++stats.destroyed;
+				}
+		};
+
+	void StatePool::prewarm(std::size_t count) {
+		while (true) {
+				{
+				std::lock_guard lock(mutex);
+
+				if (idle.size() >= count or idle.size() >= maxIdle) return;
+				}
+
+				auto L = create();
+				std::lock_guard lock(mutex);
+				idle.push_back(std::move(L));
+				}
+		};
+
+	void StatePool::clear() {
+		std::vector<std::unique_ptr<State>> dropped;
+			{
+			std::lock_guard lock(mutex);
+			dropped.swap(idle);
+			stats.destroyed += dropped.size();
+			}
+		};
+
+	StatePool::Stats StatePool::getStats() const {
+		std::lock_guard lock(mutex);
+		auto res = stats;
+		res.idle = idle.size();
+		return res;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,70 @@
+#include "lua++/StatePrototype.hpp"
+#include "lua++/Error.hpp"
+
+namespace Lua {
+	StatePrototype& StatePrototype::addLib(DefaultLibs libid) {
+		libs.push_back(libid);
+		return *this;
+		};
+
+	StatePrototype& StatePrototype::addType(const std::shared_ptr<TypeBase>& ptr) {
+		types.push_back(ptr);
+		return *this;
+		};
+
+	StatePrototype& StatePrototype::addPreloaded(const std::string& name, const CppFunction& loader) {
+		preloads.push_back({name, loader});
+		return *this;
+		};
+
+	StatePrototype& StatePrototype::addPreloaded(const std::string& name, lua_CFunction loader) {
+		preloads.push_back({name, loader});
+		return *this;
+		};
+
+	StatePrototype& StatePrototype::addBootstrap(std::string_view code, const std::string& name) {
+		// Compile in throwaway State: parser needs no libraries
+		State L(DefaultLibsPreset::NONE);
+		L.registerStandardTypes();
+		L.load(code, name);
+		scripts.push_back({name, L.dump(stripDebug)});
+		return *this;
+		};
+
+	std::unique_ptr<State> StatePrototype::instantiate(lua_Alloc alloc, void* ud) const {
+		auto L = std::make_unique<State>(preset, alloc, ud, lazyLibs);
+		replay(*L);
+		return L;
+		};
+
+	std::unique_ptr<State> StatePrototype::instantiate(std::unique_ptr<Allocator> alloc) const {
+		auto L = std::make_unique<State>(preset, std::move(alloc), lazyLibs);
+		replay(*L);
+		return L;
+		};
+
+	void StatePrototype::replay(State& L) const {
+		for (auto lib : libs) {
+				if (lazyLibs) L.loadDefaultLibLazy(lib);
+				else L.loadDefaultLib(lib);
+				}
+
+		for (const auto& type : types) {
+				L.registerType(type);
+				}
+
+		for (const auto& preload : preloads) {
+				bool ok = std::visit([&L, &preload](const auto & loader) {
+					return L.addPreloaded(preload.name, loader);
+					}, preload.loader);
+
+				if (!ok) throw Lua::Error("Can't add preloaded module \"" + preload.name + "\": package library missing");
+				}
+
+		for (const auto& script : scripts) {
+				L.load(script.bytecode, script.name, LoadMode::BINARY);
+				L.pcall(0, 0);
+				}
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,139 @@
+#include "lua++/Value.hpp"
+
+namespace Lua {
+	Value Value::fromStack(lua_State* L, int idx, bool own) {
+		switch (lua_type(L, idx)) {
+			case LUA_TBOOLEAN:
+				return Value(static_cast<bool>(lua_toboolean(L, idx)));
+
+			case LUA_TNUMBER:
+				if (lua_isinteger(L, idx)) return Value(lua_tointeger(L, idx));
+				else                       return Value(lua_tonumber(L, idx));
+
+			case LUA_TSTRING: {
+					std::size_t len = 0;
+					const char* data = lua_tolstring(L, idx, &len); // Never converts: it's a string already
+
+					if (own) return Value(std::string(data, len));
+					else     return Value(std::string_view(data, len));
+					}
+
+			case LUA_TLIGHTUSERDATA:
+				return Value(lua_touserdata(L, idx));
+
+			case LUA_TTABLE:
+			case LUA_TFUNCTION:
+			case LUA_TUSERDATA:
+			case LUA_TTHREAD:
+				return Value(Reference(L, idx));
+
+			default:
+				// `nil` or none
+				return Value();
+				}
+		};
+
+	void Value::push(lua_State* L) const {
+		luaL_checkstack(L, 1, nullptr);
+
+		switch (holder.index()) {
+			case 0:
+				lua_pushnil(L);
+				break;
+
+			case 1:
+				lua_pushboolean(L, std::get<bool>(holder));
+				break;
+
+			case 2:
+				lua_pushinteger(L, std::get<lua_Integer>(holder));
+				break;
+
+			case 3:
+				lua_pushnumber(L, std::get<lua_Number>(holder));
+				break;
+
+			case 4: {
+					const auto& str = std::get<std::string_view>(holder);
+					lua_pushlstring(L, str.data(), str.size());
+					break;
+					}
+
+			case 5: {
+					const auto& str = std::get<std::string>(holder);
+					lua_pushlstring(L, str.data(), str.size());
+					break;
+					}
+
+			case 6:
+				lua_pushlightuserdata(L, std::get<void*>(holder));
+				break;
+
+			case 7:
+				std::get<Reference>(holder).push(L);
+				break;
+
+			default:
+				lua_pushnil(L); // Valueless by exception
+				}
+		};
+
+	int Value::getLuaType() const noexcept {
+		switch (holder.index()) {
+			case 0: return LUA_TNIL;
+			case 1: return LUA_TBOOLEAN;
+			case 2: [[fallthrough]];
+			case 3: return LUA_TNUMBER;
+			case 4: [[fallthrough]];
+			case 5: return LUA_TSTRING;
+			case 6: return LUA_TLIGHTUSERDATA;
+			case 7: return std::get<Reference>(holder).getType();
+			default: return LUA_TNONE;
+				}
+		};
+
+	std::optional<bool> Value::getBoolean() const noexcept {
+		if (auto b = std::get_if<bool>(&holder)) return *b;
+
+		return {};
+		};
+
+	std::optional<Number> Value::getNumber() const noexcept {
+		if (auto num = std::get_if<lua_Integer>(&holder)) return Number(*num);
+
+		if (auto num = std::get_if<lua_Number>(&holder))  return Number(*num);
+
+		return {};
+		};
+
+	std::optional<std::string_view> Value::getString() const noexcept {
+		if (auto str = std::get_if<std::string_view>(&holder)) return *str;
+
+		if (auto str = std::get_if<std::string>(&holder))      return std::string_view(*str);
+
+		return {};
+		};
+
+	std::optional<void*> Value::getLightUserdata() const noexcept {
+		if (auto ptr = std::get_if<void*>(&holder)) return *ptr;
+
+		return {};
+		};
+
+	bool Value::toBoolean() const noexcept {
+		if (isNil()) return false;
+
+		if (auto b = std::get_if<bool>(&holder)) return *b;
+
+		return true;
+		};
+
+	Value& Value::makeOwned() {
+		if (auto str = std::get_if<std::string_view>(&holder)) {
+				holder = std::string(*str);
+				}
+
+		return *this;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
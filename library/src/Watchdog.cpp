@@ -0,0 +1,64 @@
+#include "lua++/Watchdog.hpp"
+
+namespace Lua {
+	Watchdog::Watchdog(State& state): L(state) {
+		thread = std::thread(&Watchdog::loop, this);
+		};
+
+	Watchdog::~Watchdog() {
+			{
+			std::lock_guard lock(mutex);
+			stopping = true;
+			}
+		cv.notify_one();
+		thread.join();
+		};
+
+	Watchdog::Scope Watchdog::arm(std::chrono::steady_clock::time_point when) {
+		std::uint64_t id;
+			{
+			std::lock_guard lock(mutex);
+			id = ++generation;
+			deadline = when;
+			}
+		cv.notify_one();
+		return Scope(this, id);
+		};
+
+	void Watchdog::disarm(std::uint64_t id) {
+		std::lock_guard lock(mutex);
+
+		if (generation == id) deadline.reset();
+
+		// Interruption may arrive after call has returned; don't let it hit next one
+		if (fired == id) L.clearInterrupt();
+		};
+
+	void Watchdog::loop() {
+		std::unique_lock lock(mutex);
+
+		while (!stopping) {
+				if (!deadline) {
+						cv.wait(lock);
+						}
+				else if (std::chrono::steady_clock::now() >= *deadline) {
+						L.interrupt();
+						fired = generation;
+						deadline.reset();
+						}
+				else {
+						cv.wait_until(lock, *deadline);
+						}
+				}
+		};
+
+	Watchdog::Scope::~Scope() {
+		if (dog) dog->disarm(id);
+		};
+
+	bool Watchdog::Scope::expired() const {
+		std::lock_guard lock(dog->mutex);
+		return dog->fired == id;
+		};
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,139 @@
+/*
+ * lua++_embed: compile Lua scripts into C++ source with bytecode arrays.
+ *
+ * Usage: lua++_embed [--strip] [--source-dir <dir>] <output.cpp> <function name> <module> <script.lua> [<module> <script.lua>…]
+ *
+ * Generated file defines `bool <function name>(Lua::State&)` which adds all
+ * scripts to `package.preload` using `Lua::State::addPreloadedChunk`.
+ * Chunk names are script paths relative to `--source-dir` (if given), so output
+ * doesn't depend on location of build tree.
+ * Normally invoked by `lua_embedscripts` CMake function.
+*/
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "lua++/State.hpp"
+#include "lua++/Error.hpp"
+
+namespace {
+	struct Script {
+		std::string module;
+		std::string path;
+		std::string chunkName;
+		std::string bytecode;
+		};
+
+	void writeArray(std::ostream& out, const std::string& name, const std::string& data) {
+		out << "\tconst unsigned char " << name << "[] = {";
+
+		for (std::size_t i = 0; i < data.size(); ++i) {
+				if (i % 16 == 0) out << "\n\t\t";
+
+				out << static_cast<unsigned>(static_cast<unsigned char>(data[i])) << ",";
+				}
+
+		out << "\n\t\t};\n";
+		};
+
+	// Escape string for C++ literal
+	std::string quote(const std::string& str) {
+		std::string res = "\"";
+
+		for (char c : str) {
+				if (c == '"' or c == '\\') res += '\\';
+
+				res += c;
+				}
+
+		return res + "\"";
+		};
+	};
+
+int main(int argc, const char* argv[]) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	bool strip = false;
+	std::filesystem::path sourceDir;
+
+	while (!args.empty() and args.front().rfind("--", 0) == 0) {
+			if (args.front() == "--strip") {
+					strip = true;
+					}
+			else if (args.front() == "--source-dir" and args.size() > 1) {
+					args.erase(args.begin());
+					sourceDir = args.front();
+					}
+			else break;
+
+			args.erase(args.begin());
+			}
+
+	if (args.size() < 2 or args.size() % 2 != 0) {
+			std::cerr << "Usage: " << argv[0] << " [--strip] [--source-dir <dir>] <output.cpp> <function name> <module> <script.lua> [<module> <script.lua>…]" << std::endl;
+			return EXIT_FAILURE;
+			}
+
+	std::vector<Script> scripts;
+
+	try {
+			Lua::State L(Lua::DefaultLibsPreset::NONE);
+			L.registerStandardTypes();
+
+			for (std::size_t i = 2; i < args.size(); i += 2) {
+					Script script {args[i], args[i + 1], args[i + 1], {}};
+
+					if (!sourceDir.empty()) {
+							script.chunkName = std::filesystem::path(script.path).lexically_relative(sourceDir).generic_string();
+							}
+
+					std::ifstream fin(script.path, std::ios::binary);
+
+					if (!fin) {
+							std::cerr << "Can't open " << script.path << std::endl;
+							return EXIT_FAILURE;
+							}
+
+					L.load(fin, "@" + script.chunkName);
+					script.bytecode = L.dump(strip);
+					L.pop(1);
+					scripts.push_back(std::move(script));
+					}
+			}
+	catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+			}
+
+	std::ofstream out(args[0], std::ios::binary | std::ios::trunc);
+	out << "// Generated by lua++_embed, do not edit.\n"
+		<< "#include <string_view>\n"
+		<< "#include \"lua++/State.hpp\"\n\n"
+		<< "namespace {\n";
+
+	for (std::size_t i = 0; i < scripts.size(); ++i) {
+			out << "\t// " << scripts[i].module << " (" << scripts[i].chunkName << ")\n";
+			writeArray(out, "chunk" + std::to_string(i), scripts[i].bytecode);
+			}
+
+	out << "\t};\n\n"
+		<< "bool " << args[1] << "(Lua::State& L) {\n"
+		<< "\tbool ok = true;\n";
+
+	for (std::size_t i = 0; i < scripts.size(); ++i) {
+			out << "\tok = L.addPreloadedChunk(" << quote(scripts[i].module)
+				<< ", std::string_view(reinterpret_cast<const char*>(chunk" << i << "), sizeof(chunk" << i << "))) and ok;\n";
+			}
+
+	out << "\treturn ok;\n"
+		<< "\t};\n";
+
+	if (!out) {
+			std::cerr << "Can't write " << args[0] << std::endl;
+			return EXIT_FAILURE;
+			}
+
+	return EXIT_SUCCESS;
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
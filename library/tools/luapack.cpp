@@ -0,0 +1,114 @@
+/*
+ * lua++_pack: pack Lua scripts into module archive.
+ *
+ * Usage: lua++_pack [--strip] [--source] [--source-dir <dir>] <output> <module> <script.lua> [<module> <script.lua>…]
+ *
+ * By default scripts are compiled to bytecode (in parallel), `--source` stores
+ * them as is. Result can be served with `Lua::State::addArchive`.
+ * Chunk names are script paths relative to `--source-dir` (if given), so archive
+ * doesn't depend on location of build tree.
+ * Normally invoked by `lua_packarchive` CMake function.
+*/
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "lua++/ModuleArchive.hpp"
+#include "lua++/Precompiler.hpp"
+#include "lua++/Error.hpp"
+
+int main(int argc, const char* argv[]) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	bool strip = false;
+	bool source = false;
+	std::filesystem::path sourceDir;
+
+	while (!args.empty() and args.front().rfind("--", 0) == 0) {
+			if (args.front() == "--strip") {
+					strip = true;
+					}
+			else if (args.front() == "--source") {
+					source = true;
+					}
+			else if (args.front() == "--source-dir" and args.size() > 1) {
+					args.erase(args.begin());
+					sourceDir = args.front();
+					}
+			else break;
+
+			args.erase(args.begin());
+			}
+
+	if (args.size() < 3 or args.size() % 2 != 1) {
+			std::cerr << "Usage: " << argv[0] << " [--strip] [--source] [--source-dir <dir>] <output> <module> <script.lua> [<module> <script.lua>…]" << std::endl;
+			return EXIT_FAILURE;
+			}
+
+	std::map<std::string, std::string> modules;
+
+	try {
+			Lua::Precompiler batch(strip);
+			std::vector<std::string> names;
+
+			for (std::size_t i = 1; i < args.size(); i += 2) {
+					const auto& module = args[i];
+					const auto& path = args[i + 1];
+					std::ifstream fin(path, std::ios::binary);
+
+					if (!fin) {
+							std::cerr << "Can't open " << path << std::endl;
+							return EXIT_FAILURE;
+							}
+
+					if (modules.count(module) != 0) {
+							std::cerr << "Duplicate module " << module << std::endl;
+							return EXIT_FAILURE;
+							}
+
+					std::string code(std::istreambuf_iterator<char>(fin), {});
+
+					if (source) {
+							modules[module] = std::move(code);
+							}
+					else {
+							auto chunkName = path;
+
+							if (!sourceDir.empty()) {
+									chunkName = std::filesystem::path(path).lexically_relative(sourceDir).generic_string();
+									}
+
+							modules[module];
+							names.push_back(module);
+							batch.addSource(std::move(code), "@" + chunkName);
+							}
+					}
+
+			auto results = batch.run();
+			bool ok = true;
+
+			for (std::size_t i = 0; i < results.size(); ++i) {
+					if (results[i].ok()) {
+							modules[names[i]] = std::move(results[i].bytecode);
+							}
+					else {
+							std::cerr << results[i].error->what() << std::endl;
+							ok = false;
+							}
+					}
+
+			if (!ok) return EXIT_FAILURE;
+
+			Lua::ModuleArchive::write(args[0], modules);
+			}
+	catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+			}
+
+	return EXIT_SUCCESS;
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
@@ -0,0 +1,356 @@
+/*
+ * lua++-bench: microbenchmarks of common lua++ operations.
+ *
+ * Usage: lua++-bench [--format=text|csv|json] [--filter=substring] [--min-time=ms]
+ *
+ * Every benchmark is run until it takes at least `min-time` (200 ms by default)
+ * and reports time and allocations per operation. Lua allocations are counted by
+ * State's allocator, C++ ones by replaced global `operator new`. Use `csv` or
+ * `json` output to compare results between lua++ versions.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "lua++/State.hpp"
+#include "lua++/TypeHelper.hpp"
+
+using namespace Lua::NumberLiterals;
+
+namespace {
+	std::size_t cppAllocations = 0; ///< Number of `operator new` calls.
+	std::size_t luaAllocations = 0; ///< Number of blocks allocated by States.
+
+	/// Same as default %Lua allocator, but counts allocations.
+	void* countingAlloc(void*, void* ptr, std::size_t, std::size_t nsize) noexcept {
+		if (nsize == 0) {
+				std::free(ptr);
+				return nullptr;
+				}
+
+		if (!ptr) ++luaAllocations;
+
+		return std::realloc(ptr, nsize);
+		};
+	};
+
+void* operator new(std::size_t size) {
+	++cppAllocations;
+
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+
+	throw std::bad_alloc();
+	};
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+	};
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+	};
+
+int luaopen_lpeg(lua_State* L);
+
+namespace {
+	/// Run `n` operations.
+	using Body = std::function<void(std::size_t n)>;
+
+	/// Single benchmark.
+	struct Benchmark {
+		std::string name;                 ///< Name (`group/case`).
+		std::function<Body()> prepare;    ///< Create State and everything else body needs (not measured).
+		};
+
+	/// Benchmark results.
+	struct Result {
+		std::string name;                 ///< Benchmark name.
+		std::size_t iterations = 0;       ///< Operations done in measured run.
+		double nsPerOp = 0;               ///< Time per operation.
+		double luaAllocsPerOp = 0;        ///< %Lua allocations per operation.
+		double cppAllocsPerOp = 0;        ///< C++ allocations per operation.
+		};
+
+	/// Load chunk running `f(i)` in loop, with `f` given as argument.
+	void loadCallLoop(Lua::State& L) {
+		L.load("local f, n = ... for i = 1, n do f(i) end", "=bench");
+		};
+
+	int rawFunction(lua_State* L) {
+		lua_pushinteger(L, luaL_checkinteger(L, 1));
+		return 1;
+		};
+
+	int cppFunction(Lua::StatePtr& Lp) {
+		lua_pushinteger(**Lp, luaL_checkinteger(**Lp, 2));
+		return 1;
+		};
+
+	class BenchObject {
+		public:
+			static const Lua::MethodsTable<BenchObject> methods;
+
+			int get(Lua::StatePtr& Lp) { Lp->push(Lua::Number(value)); return 1; };
+			Lua::Number add(lua_Integer x) { value += x; return Lua::Number(value); };
+		private:
+			lua_Integer value = 0;
+		};
+
+	const Lua::MethodsTable<BenchObject> BenchObject::methods = {
+		Lua::CppMethodPair("get", &BenchObject::get),
+		Lua::CppMethodNativePair<Lua::Number>("add", &BenchObject::add),
+		};
+
+	/// Fresh State using counting allocator.
+	std::shared_ptr<Lua::State> makeState(Lua::DefaultLibsPreset preset = Lua::DefaultLibsPreset::SAFE) {
+		auto L = std::make_shared<Lua::State>(preset, countingAlloc, nullptr);
+		L->registerType(std::make_shared<Lua::TypeHelper<BenchObject>>());
+		return L;
+		};
+
+	/// Benchmark of pushing value and getting it back.
+	template<typename T>
+	Benchmark pushGet(const std::string& name, T value) {
+		return {"push_get/" + name, [value] {
+			auto L = makeState();
+			return Body([L, value](std::size_t n) {
+				for (std::size_t i = 0; i < n; ++i) {
+						L->push(value);
+						[[maybe_unused]] auto res = L->getOne<T>(-1);
+						L->pop(1);
+						}
+				});
+			}};
+		};
+
+	/// Benchmark of calling function at top of stack from %Lua loop.
+	Benchmark callFrom(const std::string& name, std::function<void(Lua::State&)> pushFunc) {
+		return {"call/" + name, [pushFunc] {
+			auto L = makeState();
+			return Body([L, pushFunc](std::size_t n) {
+				loadCallLoop(*L);
+				pushFunc(*L);
+				L->push(Lua::Number(static_cast<lua_Integer>(n)));
+				L->pcall(2, 0);
+				});
+			}};
+		};
+
+	/// Benchmark of running %Lua code (`n` is passed as `...`).
+	Benchmark runLua(const std::string& name, const std::string& code, std::function<void(Lua::State&)> setup = nullptr) {
+		return {name, [code, setup] {
+			auto L = makeState(Lua::DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE);
+			L->addPreloaded("lpeg", luaopen_lpeg);
+
+			if (setup) setup(*L);
+
+			return Body([L, code](std::size_t n) {
+				L->load(code, "=bench");
+				L->push(Lua::Number(static_cast<lua_Integer>(n)));
+				L->pcall(1, 0);
+				});
+			}};
+		};
+
+	/// Benchmark of loading chunk.
+	Benchmark loadChunk(const std::string& name, const std::string& code) {
+		return {"load/" + name, [code] {
+			auto L = makeState();
+			return Body([L, code](std::size_t n) {
+				for (std::size_t i = 0; i < n; ++i) {
+						L->load(code, "=bench");
+						L->pop(1);
+						}
+				});
+			}};
+		};
+
+	/// Chunk with many functions, like big module.
+	std::string largeChunk() {
+		std::string res = "local M = {}\n";
+
+		for (int i = 0; i < 500; ++i) {
+				auto n = std::to_string(i);
+				res += "function M.f" + n + "(a, b)\n\tlocal t = {a, b, '" + n + "'}\n\tif a > b then return t[1] else return #t + " + n + " end\nend\n";
+				}
+
+		return res + "return M\n";
+		};
+
+	std::vector<Benchmark> allBenchmarks() {
+		std::vector<Benchmark> res;
+
+		for (auto [name, preset] : {
+					std::pair{"none", Lua::DefaultLibsPreset::NONE},
+					std::pair{"safe", Lua::DefaultLibsPreset::SAFE},
+					std::pair{"all", Lua::DefaultLibsPreset::ALL}
+					}) {
+				res.push_back({std::string("state/construct_") + name, [preset = preset] {
+					return Body([preset](std::size_t n) {
+						for (std::size_t i = 0; i < n; ++i) {
+								Lua::State L(preset, countingAlloc, nullptr);
+								}
+						});
+					}});
+				}
+
+		res.push_back(pushGet("nil", nullptr));
+		res.push_back(pushGet("bool", true));
+		res.push_back(pushGet("integer", 42_li));
+		res.push_back(pushGet("float", 4.2_ln));
+		res.push_back(pushGet("string_short", std::string("hello")));
+		res.push_back(pushGet("string_1k", std::string(1024, 'x')));
+		res.push_back(pushGet("cppfunction", Lua::CppFunction(cppFunction)));
+		res.push_back(pushGet("object", std::make_shared<BenchObject>()));
+
+		res.push_back(callFrom("lua_cfunction", [](Lua::State & L) {
+			lua_pushcfunction(L, rawFunction);
+			}));
+		res.push_back(callFrom("cppfunction", [](Lua::State & L) {
+			L.push(Lua::CppFunction(cppFunction));
+			}));
+		res.push_back(callFrom("cppfunctionwrapper", [](Lua::State & L) {
+			L.push(Lua::CppFunctionWrapper(cppFunction));
+			}));
+		res.push_back(callFrom("cppfunction_native", [](Lua::State & L) {
+			L.push(Lua::CppFunction(Lua::CppFunctionNative<Lua::Number>([](lua_Integer x) { return Lua::Number(x); })));
+			}));
+
+		auto setObject = [](Lua::State & L) {
+			L.push(std::make_shared<BenchObject>());
+			lua_setglobal(L, "obj");
+			};
+		res.push_back(runLua("method/bind", "for i = 1, ... do obj:get() end", setObject));
+		res.push_back(runLua("method/native", "for i = 1, ... do obj:add(1) end", setObject));
+		res.push_back(runLua("method/lookup_cached", "local get = obj.get for i = 1, ... do get(obj) end", setObject));
+
+		res.push_back(loadChunk("small", "return 1 + 1"));
+		res.push_back(loadChunk("large", largeChunk()));
+
+		res.push_back(runLua("lpeg/compile", R"(
+			local lpeg = require 'lpeg'
+			local P, R, S, C, Ct = lpeg.P, lpeg.R, lpeg.S, lpeg.C, lpeg.Ct
+			for i = 1, ... do
+				local space = S' \t'^0
+				local number = C(R'09'^1 * (P'.' * R'09'^1)^-1) * space
+				local list = Ct(number * (P',' * space * number)^0)
+				lpeg.match(list, '')
+			end
+			)"));
+		res.push_back(runLua("lpeg/match", R"(
+			local lpeg = require 'lpeg'
+			local P, R, S, C, Ct = lpeg.P, lpeg.R, lpeg.S, lpeg.C, lpeg.Ct
+			local space = S' \t'^0
+			local number = C(R'09'^1 * (P'.' * R'09'^1)^-1) * space
+			local list = Ct(number * (P',' * space * number)^0)
+			local subject = '1, 2.5, 300, 4, 5.75, 60, 7, 8.125, 9, 10'
+			for i = 1, ... do lpeg.match(list, subject) end
+			)"));
+
+		return res;
+		};
+
+	/// Run body `n` times and measure it.
+	Result measure(const Body& body, std::size_t n) {
+		Result res;
+		res.iterations = n;
+		auto lua = luaAllocations;
+		auto cpp = cppAllocations;
+		auto start = std::chrono::steady_clock::now();
+		body(n);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		res.nsPerOp = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / n;
+		res.luaAllocsPerOp = static_cast<double>(luaAllocations - lua) / n;
+		res.cppAllocsPerOp = static_cast<double>(cppAllocations - cpp) / n;
+		return res;
+		};
+
+	/// Find iteration count which takes at least `minTime` and report that run.
+	Result run(const Benchmark& bench, std::chrono::nanoseconds minTime) {
+		auto body = bench.prepare();
+		body(1); // Warm up
+		std::size_t n = 1;
+
+		while (true) {
+				auto res = measure(body, n);
+				double elapsed = res.nsPerOp * n;
+
+				if (elapsed >= static_cast<double>(minTime.count()) or n >= (std::size_t(1) << 30)) {
+						res.name = bench.name;
+						return res;
+						}
+
+				// Aim a bit higher than needed, but don't grow too fast on noisy short runs
+				double target = static_cast<double>(minTime.count()) * 1.2 / std::max(res.nsPerOp, 1.0);
+				n = static_cast<std::size_t>(std::min(target, static_cast<double>(n) * 100)) + 1;
+				}
+		};
+
+	void printResult(const Result& res, const std::string& format, bool first) {
+		if (format == "csv") {
+				if (first) std::cout << "name,iterations,ns_per_op,lua_allocs_per_op,cpp_allocs_per_op\n";
+
+				std::cout << res.name << ',' << res.iterations << ',' << res.nsPerOp << ','
+						  << res.luaAllocsPerOp << ',' << res.cppAllocsPerOp << '\n';
+				}
+		else if (format == "json") {
+				std::cout << (first ? "[\n" : ",\n") << "  {\"name\": \"" << res.name << "\", \"iterations\": " << res.iterations
+						  << ", \"ns_per_op\": " << res.nsPerOp << ", \"lua_allocs_per_op\": " << res.luaAllocsPerOp
+						  << ", \"cpp_allocs_per_op\": " << res.cppAllocsPerOp << "}";
+				}
+		else {
+				if (first) {
+						std::cout << std::left << std::setw(32) << "benchmark" << std::right << std::setw(14) << "ns/op"
+								  << std::setw(14) << "lua allocs/op" << std::setw(14) << "C++ allocs/op" << '\n';
+						}
+
+				std::cout << std::left << std::setw(32) << res.name << std::right << std::fixed << std::setprecision(1)
+						  << std::setw(14) << res.nsPerOp << std::setprecision(2)
+						  << std::setw(14) << res.luaAllocsPerOp << std::setw(14) << res.cppAllocsPerOp << '\n';
+				}
+		};
+	};
+
+int main(int argc, const char* argv[]) {
+	std::string format = "text";
+	std::string filter;
+	std::chrono::nanoseconds minTime = std::chrono::milliseconds(200);
+
+	for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+
+			if (arg.rfind("--format=", 0) == 0) format = arg.substr(9);
+			else if (arg.rfind("--filter=", 0) == 0) filter = arg.substr(9);
+			else if (arg.rfind("--min-time=", 0) == 0) minTime = std::chrono::milliseconds(std::atoi(arg.c_str() + 11));
+			else {
+					std::cerr << "Usage: " << argv[0] << " [--format=text|csv|json] [--filter=substring] [--min-time=ms]" << std::endl;
+					return EXIT_FAILURE;
+					}
+			}
+
+	bool first = true;
+
+	try {
+			for (const auto& bench : allBenchmarks()) {
+					if (bench.name.find(filter) == std::string::npos) continue;
+
+					printResult(run(bench, minTime), format, first);
+					first = false;
+					}
+			}
+	catch (const std::exception& e) {
+			std::cerr << "Benchmark failed: " << e.what() << std::endl;
+			return EXIT_FAILURE;
+			}
+
+	if (format == "json") std::cout << (first ? "[]\n" : "\n]\n");
+
+	return EXIT_SUCCESS;
+	};
+// kate: indent-mode cstyle; indent-width 4; replace-tabs off; tab-width 4;
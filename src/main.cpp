@@ -1,14 +1,22 @@
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include "lua++/State.hpp"
 #include "lua++/TypeHelper.hpp"
+#include "lua++/TableView.hpp"
+#include "lua++/StatePool.hpp"
+#include "lua++/StatePrototype.hpp"
+#include "lua++/BytecodeCache.hpp"
+#include "lua++/Precompiler.hpp"
+#include "lua++/ModuleArchive.hpp"
+#include "lua++/ModuleDirectory.hpp"
+#include "lua++/Scheduler.hpp"
+#include "lua++/Watchdog.hpp"
 #include "lua++/Error.hpp"
 #include <assert.h>
 
-// Set to `true` to run test code 6000 times (for profiling of unobvious bugs)
-constexpr bool doProfiling = false;
-
 using namespace std::string_literals; // for s
 using namespace Lua::NumberLiterals;  // for _ln and _li
 
@@ -40,6 +48,21 @@ class MyTestClass {
 
 class EmptyClass {};
 
+// Can't be copied, so it can only get into Lua by moving
+class MoveOnlyClass {
+	public:
+		explicit MoveOnlyClass(std::string str): data(std::make_unique<std::string>(std::move(str))) {};
+		static const Lua::MethodsTable<MoveOnlyClass> methods;
+
+		std::string Get() { return *data; };
+	private:
+		std::unique_ptr<std::string> data;
+	};
+
+const Lua::MethodsTable<MoveOnlyClass> MoveOnlyClass::methods = {
+	Lua::CppMethodNativePair<>("Get", &MoveOnlyClass::Get)
+	};
+
 const Lua::FunctionsTable MyTestClass::metamethods = {
 	//{"__call", [](Lua::StatePtr & Lp) { Lp->push("Who called me? ^_^"); return 1; }}
 		{
@@ -165,6 +188,58 @@ void testBasic() {
 		std::cout << "We got " << rescnt << " results (from 0)" << std::endl;
 		}
 
+	// Stack is empty
+	// Testing dynamic values
+
+		{
+		lua_getglobal(L, "print");
+		L.push(Lua::Value("Dynamic"), Lua::Value(7_li), Lua::Value(), Lua::Value(true));
+		static const Lua::Key printKey("print"); // Interned once, no hashing on futher calls
+		L.getGlobal(printKey);
+		auto [str, num, nil, b, func] = L.get<Lua::Value, Lua::Value, Lua::Value, Lua::Value, Lua::Value>(2, true);
+		std::cout << *str->getString() << " " << (lua_Integer)*num->getNumber() << " " << nil->isNil() << " " << b->toBoolean() << " " << (func->getLuaType() == LUA_TFUNCTION) << std::endl;
+		assert(Lua::Value(1).isInteger() and Lua::Value(1.5).isFloat()); // Plain literals pick right alternative
+		lua_pop(L, 1);
+		L.pcall(4);
+		}
+
+	// Stack is empty
+	// Testing path lookup
+
+		{
+		static const Lua::Path maxConn("server.limits.max_conn");
+		static const Lua::Path missing("server.nothing.here");
+		L.load("return {server = {limits = {max_conn = 64}}}", "=config");
+		L.pcall(0, 1);
+		Lua::Reference cfg(L, -1);
+		lua_pop(L, 1);
+		auto conn = L.getPath<Lua::Number>(cfg, maxConn);
+		auto miss = L.getPath<Lua::Number>(cfg, missing);
+		std::cout << "Config says " << (lua_Integer)conn.value() << ", missing one is " << (miss ? "present" : "absent") << std::endl;
+		}
+
+	// Stack is empty
+	// Testing table iteration
+
+		{
+		L.load("return {10, 20, 30.5, 'not a number', answer = 42}");
+		L.pcall(0, 1);
+		Lua::TableView view(L, -1);
+		lua_Number sum = 0;
+
+		for (auto num : view.array<Lua::Number>()) {
+				sum += (lua_Number)num.value_or(0_li);
+				}
+
+		std::cout << "Array sum: " << sum << std::endl;
+
+		for (auto [key, value] : view.pairs<std::string_view, Lua::Value>()) {
+				if (key) std::cout << "Named field " << *key << " is a number: " << value->isNumber() << std::endl;
+				}
+
+		lua_pop(L, 1);
+		}
+
 	// Stack is empty
 	// Testing optionals
 
@@ -314,6 +389,23 @@ print("Doing test:", echoFunc(1,2,3,4))
 		helper->pushStatic(Lp);
 		L.pcall(1, 0);
 		}
+
+	// Test pushing rvalues (temporaries and move-only objects)
+
+		{
+		L.registerType(std::make_shared<Lua::TypeHelper<MoveOnlyClass>>());
+		auto obj = std::make_shared<MoveOnlyClass>("I was moved");
+		L.push(std::move(obj), "I'm temporary"s, Lua::CppFunction([](Lua::StatePtr & Lp) {
+			Lp->push("So am I"s);
+			return 1;
+			}));
+		assert(!obj); // Reference was stolen, not copied
+		lua_setglobal(L, "tempFunc");
+		lua_setglobal(L, "tempStr");
+		lua_setglobal(L, "movedObj");
+		L.load("print(movedObj:Get(), tempStr, tempFunc())");
+		L.pcall(0, 0);
+		}
 	}
 
 int cloader(lua_State* L) {
@@ -359,6 +451,304 @@ print(pcall(require, 'i_do_not_exsist'))
 		);
 		L.pcall(0);
 		}
+		{
+		std::cout << "Testing module archive" << std::endl;
+		Lua::ModuleArchive::write("test_modules.lar", {
+				{"archived", "return {answer = 42}"},
+				{"archived.sub", "return 'nested module'"}
+			});
+		Lua::State L(Lua::DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE);
+		L.addArchive(std::make_shared<Lua::ModuleArchive>("test_modules.lar"));
+		L.load(
+			R"LUA(
+print(require('archived').answer, require('archived.sub'))
+print(pcall(require, 'not_archived'))
+		  )LUA"
+		);
+		L.pcall(0);
+		std::remove("test_modules.lar");
+		}
+		{
+		std::cout << "Testing module directory" << std::endl;
+		auto dir = std::make_shared<Lua::ModuleDirectory>(".");
+		Lua::State L(Lua::DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE);
+		L.addDirectory(dir);
+		L.load(
+			R"LUA(
+print(require('embedded_module').hello())
+print(pcall(require, 'syntax_error'))
+print(pcall(require, '..secret'))
+		  )LUA"
+		);
+		L.pcall(0);
+		}
+		{
+		std::cout << "Testing lazy libraries" << std::endl;
+		Lua::State L(Lua::DefaultLibsPreset::SAFE_WITH_PACKAGE, nullptr, nullptr, true);
+		L.load(
+			R"LUA(
+print('math opened:', rawget(_G, 'math') ~= nil, math.floor(2.5), rawget(_G, 'math') ~= nil)
+print('utf8 via require:', require('utf8') == utf8, ('string'):upper())
+		  )LUA"
+		);
+		L.pcall(0);
+		}
+	};
+
+void testPool() {
+	Lua::StatePrototype proto(Lua::DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE);
+	proto.addType(std::make_shared<Lua::TypeHelper<MyTestClass>>())
+	.addPreloaded("cloader", cloader)
+	.addBootstrap("greeting = 'Hello from bootstrap bytecode'");
+	auto cache = std::make_shared<Lua::BytecodeCache>();
+	Lua::StatePool pool([&proto, &cache] {
+		auto L = proto.instantiate(std::make_unique<Lua::PoolAllocator>());
+		L->setBytecodeCache(cache);
+		return L;
+		}, 1);
+
+	for (int i = 0; i < 2; ++i) {
+			auto L = pool.acquire();
+			L->load("print(greeting, 'Leaked global:', leaked); leaked = 'oops'");
+			L->pcall(0, 0);
+			}
+
+	auto stats = pool.getStats();
+	std::cout << "Pool: " << stats.created << " created, " << stats.reused << " reused, high-water " << stats.highWater << std::endl;
+	std::cout << "Bytecode cache: " << cache->getStats().hits << " hits, " << cache->getStats().misses << " misses" << std::endl;
+	};
+
+void testMemory() {
+	Lua::State L(Lua::DefaultLibsPreset::SAFE, std::make_unique<Lua::AccountingAllocator>(1024 * 1024, std::make_unique<Lua::PoolAllocator>()));
+	L.load("local t = {} for i = 1, 1e7 do t[i] = tostring(i) end");
+
+	try {
+			L.pcall(0, 0);
+			}
+	catch (const Lua::MemoryLimitError& e) {
+			std::cout << "Memory limit hit (expected): " << e.what() << std::endl;
+			}
+
+	auto stats = L.memoryStats();
+	std::cout << "Memory: " << stats.current << " bytes now, " << stats.peak << " peak, " << stats.allocations << " allocations" << std::endl;
+
+	// Per-request States sharing one arena
+	Lua::ArenaAllocator arena;
+
+	for (int i = 0; i < 3; ++i) {
+			{
+			Lua::State req(Lua::DefaultLibsPreset::SAFE, Lua::Allocator::luaAlloc, &arena);
+			req.load("local s = '' for i = 1, 100 do s = s .. i end");
+			req.pcall(0, 0);
+			}
+			arena.reset();
+			}
+
+	std::cout << "Arena chunks after 3 requests: " << arena.getChunkCount() << std::endl;
+
+	// Collection in idle time only
+	Lua::State frames(Lua::DefaultLibsPreset::SAFE);
+	frames.gc().stop();
+
+	for (int frame = 0; frame < 3; ++frame) {
+			frames.load("local t = {} for i = 1, 1e4 do t[i] = {} end");
+			frames.pcall(0, 0);
+			auto work = frames.gc().step(std::chrono::milliseconds(1));
+			std::cout << "Frame " << frame << ": " << work.steps << " GC steps freed " << work.freed << " bytes" << std::endl;
+			}
+	};
+
+void testLimits() {
+	Lua::State L(Lua::DefaultLibsPreset::SAFE);
+
+	// Script trying to survive by catching error
+	L.load("while true do pcall(function() while true do end end) end");
+
+	try {
+			L.pcall(0, 0, Lua::CallBudget::timeout(std::chrono::milliseconds(20)));
+			}
+	catch (const Lua::TimeoutError& e) {
+			std::cout << "Timeout (expected): " << e.what() << std::endl;
+			}
+
+	L.load("local n = 0 for i = 1, 1e9 do n = n + i end");
+
+	try {
+			L.pcall(0, 0, Lua::CallBudget::steps(100000));
+			}
+	catch (const Lua::TimeoutError& e) {
+			std::cout << "Instruction budget (expected): " << e.what() << std::endl;
+			}
+
+	// Coroutine created earlier can't escape budget either
+	L.load("local spin = coroutine.wrap(function() while true do end end) return function() spin() end");
+	L.pcall(0, 1);
+
+	try {
+			L.pcall(0, 0, Lua::CallBudget::timeout(std::chrono::milliseconds(20)));
+			}
+	catch (const Lua::TimeoutError& e) {
+			std::cout << "Coroutine timeout (expected): " << e.what() << std::endl;
+			}
+
+	// State is still usable
+	L.load("return 2 + 2");
+	L.pcall(0, 1, Lua::CallBudget::steps(100));
+	std::cout << "After timeout: " << (lua_Integer)L.getOne<Lua::Number>(-1).value() << std::endl;
+	L.pop(1);
+
+	// Deadline enforced from outside
+	Lua::Watchdog watchdog(L);
+	L.load("while true do end");
+
+	try {
+			auto scope = watchdog.arm(std::chrono::milliseconds(20));
+			L.pcall(0, 0);
+			}
+	catch (const Lua::InterruptedError& e) {
+			std::cout << "Interrupted by watchdog (expected): " << e.what() << std::endl;
+			}
+
+	// Same for coroutine created before and spinning inside
+	L.load("local spin = coroutine.wrap(function() while true do end end) return function() spin() end");
+	L.pcall(0, 1);
+
+	try {
+			auto scope = watchdog.arm(std::chrono::milliseconds(20));
+			L.pcall(0, 0);
+			}
+	catch (const Lua::InterruptedError& e) {
+			std::cout << "Coroutine interrupted by watchdog (expected): " << e.what() << std::endl;
+			}
+
+	// Binding running Lua code itself can't swallow interruption either
+	L.push(Lua::CppFunction([](Lua::StatePtr & Lp) {
+		Lp->load("while true do end");
+		Lp->pcall(0, 0);
+		return 0;
+		}));
+	lua_setglobal(L, "nested");
+	L.load("while true do pcall(nested) end");
+
+	try {
+			auto scope = watchdog.arm(std::chrono::milliseconds(20));
+			L.pcall(0, 0);
+			}
+	catch (const Lua::InterruptedError& e) {
+			std::cout << "Nested call interrupted by watchdog (expected): " << e.what() << std::endl;
+			}
+
+	// Spinning tasks share time according to priority
+	Lua::Scheduler sched(L);
+	sched.setCompletionHandler([](const Lua::Scheduler::TaskInfo & info) {
+		std::cout << "Task " << info.id << " done after " << info.slices << " slices" << std::endl;
+		});
+	std::vector<Lua::Scheduler::TaskId> spinners;
+
+	for (int priority : {1, 3}) {
+			L.load("while true do end");
+			spinners.push_back(sched.spawn(0, priority));
+			}
+
+	// Task spinning inside coroutines (one of them created before task) is preempted too
+	L.load("local spin = coroutine.wrap(function() while true do end end) "
+		   "return function() coroutine.resume(coroutine.create(function() spin() end)) end");
+	L.pcall(0, 1);
+	spinners.push_back(sched.spawn(0));
+
+	L.load("local n = ... for i = 1, n do coroutine.yield() end");
+	L.pushOne(5_li);
+	sched.spawn(1);
+
+	sched.runFor(std::chrono::milliseconds(40));
+
+	for (auto id : spinners) {
+			auto info = sched.getInfo(id).value();
+			std::cout << "Spinner with priority " << info.priority << ": "
+					  << std::chrono::duration_cast<std::chrono::milliseconds>(info.cpuTime).count() << " ms, "
+					  << info.preemptions << " preemptions" << std::endl;
+			sched.cancel(id);
+			}
+	};
+
+void testProfiler() {
+	Lua::State L(Lua::DefaultLibsPreset::SAFE);
+	L.push((Lua::CppFunction)echoFunc);
+	lua_setglobal(L, "echo");
+	L.push(Lua::CppFunction([](Lua::StatePtr&) {
+		// Busy binding: its time must show up as its own frame
+		auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(200);
+
+		while (std::chrono::steady_clock::now() < end) {}
+
+		return 0;
+		}));
+	lua_setglobal(L, "busy");
+	L.load(R"(
+		local function fib(n) if n < 2 then return n end return fib(n - 1) + fib(n - 2) end
+		local function work() for i = 1, 2000 do echo(i) end for i = 1, 50 do busy() end return fib(24) end
+		work()
+	)", "=profiled");
+
+	L.startProfiler(std::chrono::microseconds(100));
+	L.pcall(0, 0);
+	L.stopProfiler();
+	assert(L.getProfiler()->folded().find(";busy [C++] ") != std::string::npos);
+
+	std::cout << L.getProfiler()->getSampleCount() << " samples:" << std::endl << L.getProfiler()->folded();
+
+	// Which bindings take time
+	L.registerType(std::make_shared<Lua::TypeHelper<MyTestClass>>());
+	L.enableCallStats();
+	L.push(std::make_shared<MyTestClass>());
+	lua_setglobal(L, "obj");
+	L.load("for i = 1, 1000 do echo(i) obj:MethodManyRes() end", "=stats");
+	L.pcall(0, 0);
+	L.getCallStats()->writeReport(std::cout);
+	};
+
+void testPrecompile() {
+	Lua::Precompiler batch;
+	batch.addSource("return 'first chunk'", "=first")
+	.addSource("return 'second chunk'", "=second")
+	.addSource("return )", "=broken");
+	Lua::State L(Lua::DefaultLibsPreset::SAFE);
+
+	for (const auto& chunk : batch.run()) {
+			try {
+					chunk.load(L);
+					L.pcall(0, 1);
+					std::cout << chunk.name << ": " << L.getOne<std::string>(-1).value() << std::endl;
+					L.pop(1);
+					}
+			catch (const Lua::SyntaxError& e) {
+					std::cout << "Syntax error (expected): " << e.what() << std::endl;
+					}
+			}
+
+	// Precompiled script with shebang line, like ones produced by `luac` for direct execution
+	L.load("return 'shebang and bytecode'");
+	auto path = std::filesystem::temp_directory_path() / "lua++_shebang.luac";
+		{
+		std::ofstream fout(path, std::ios::binary);
+		fout << "#!/usr/bin/env lua\n" << L.dump();
+		}
+	L.pop(1);
+	L.loadFile(path.string(), Lua::LoadMode::BOTH);
+	L.pcall(0, 1);
+	std::cout << L.getOne<std::string>(-1).value() << std::endl;
+	L.pop(1);
+	std::filesystem::remove(path);
+	};
+
+// Generated by `lua_embedscripts` in CMakeLists.txt
+bool registerEmbeddedScripts(Lua::State& L);
+
+void testEmbedded() {
+	Lua::State L(Lua::DefaultLibsPreset::SAFE_WITH_STRIPPED_PACKAGE);
+	registerEmbeddedScripts(L);
+	L.load("print(require('embedded_module').hello())");
+	L.pcall(0, 0);
 	};
 
 int luaopen_lpeg(lua_State* L);
@@ -384,30 +774,21 @@ void myStuff() {
 void doTests() {
 	testBasic();
 	testPackage();
+	testPool();
+	testMemory();
+	testLimits();
+	testProfiler();
+	testPrecompile();
+	testEmbedded();
 	testLpeg();
 	};
 
 int main(int argc, const char* argv[]) {
-	/*
-	 * Profiling on my PC (6000 runs, output redirected to `/dev/null`):
-	 * Clang 8.0.0:
-	 * Debug:   ~8.8s = 681 run/s
-	 * Release: ~4.8-4.9s = 1250 run/s
-	 * GCC 8.3.0:
-	 * Debug:   ~8.5s = 705 run/s
-	 * Release: ~4.8-4.9s = 1250 run/s
-	 *
-	 * NOTE: tests must be done in `test_files` directory to do them all
-	*/
+	// NOTE: tests must be done in `test_files` directory to do them all
+	// (for performance measurements, see `lua++-bench`)
 	try {
-			if constexpr(doProfiling) {
-					for (size_t i = 0; i < 6000; ++i)
-						doTests();
-					}
-			else {
-					doTests();
-					//myStuff();
-					}
+			doTests();
+			//myStuff();
 			}
 	catch (const std::exception& e) {
 			std::cerr << "Exception caught! what(): " << e.what() << std::endl;
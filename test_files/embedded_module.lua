@@ -0,0 +1,5 @@
+-- Compiled into test binary by lua_embedscripts
+local name = ...
+return {
+	hello = function() return "Hello from embedded module " .. name end
+}